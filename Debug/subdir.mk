@@ -5,16 +5,25 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
 ../TokenReader.cpp \
+../interp.cpp \
 ../main.cpp \
 ../parse.cpp 
 
 OBJS += \
 ./TokenReader.o \
+./interp.o \
 ./main.o \
 ./parse.o 
 
+# the interpreter library, everything but the command line
+LIB_OBJS += \
+./TokenReader.o \
+./interp.o \
+./parse.o 
+
 CPP_DEPS += \
 ./TokenReader.d \
+./interp.d \
 ./main.d \
 ./parse.d 
 
@@ -23,7 +32,7 @@ CPP_DEPS += \
 %.o: ../%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: Cygwin C++ Compiler'
-	g++ -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@)" -o "$@" "$<"
+	g++ -std=c++20 -O0 -g3 -Wall -c -fmessage-length=0 -fPIC -pthread -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
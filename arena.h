@@ -0,0 +1,159 @@
+/*
+ * arena.h
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <new>
+#include "memory.h"
+using namespace std;
+
+// bump allocator for the string payloads created while a program runs.
+// Nothing is freed individually; reset() rewinds to the first chunk in O(1)
+// and keeps the chunks for the next execution, so running the same script
+// again does not go back to malloc at all. Since dead strings are not
+// reclaimed until the reset, an execution stops using the arena once it has
+// handed out limit bytes and falls back to the heap
+class ExecArena {
+	static const size_t CHUNK = 64 * 1024;
+
+	size_t limit;
+
+	struct Chunk {
+		char *base;
+		size_t size;
+	};
+
+	vector<Chunk> chunks;
+	size_t current;
+	size_t used;
+	size_t handedOut;
+	// allocations since the last reset, live in MemoryStats until it
+	size_t live;
+
+public:
+	// allocation counters, reported by --alloc-report
+	struct Stats {
+		size_t allocations;
+		size_t bytes;
+		size_t chunkMallocs;
+		size_t resets;
+	} stats;
+
+	ExecArena(size_t limit = 64 * 1024 * 1024) :
+			limit(limit), current(0), used(0), handedOut(0), live(0), stats() {
+	}
+	~ExecArena() {
+		MemoryStats::removeString(handedOut, live);
+		for (size_t i = 0; i < chunks.size(); i++) {
+			free(chunks[i].base);
+		}
+	}
+	ExecArena(const ExecArena&) = delete;
+	ExecArena& operator=(const ExecArena&) = delete;
+
+	void *allocate(size_t n, size_t align = alignof(max_align_t)) {
+		stats.allocations++;
+		stats.bytes += n;
+		MemoryStats::addString(n);
+		handedOut += n;
+		live++;
+		while (current < chunks.size()) {
+			size_t start = (used + align - 1) & ~(align - 1);
+			if (start + n <= chunks[current].size) {
+				used = start + n;
+				return chunks[current].base + start;
+			}
+			current++;
+			used = 0;
+		}
+		Chunk c;
+		c.size = n > CHUNK ? n : CHUNK;
+		c.base = static_cast<char *>(malloc(c.size));
+		if (!c.base) {
+			throw bad_alloc();
+		}
+		stats.chunkMallocs++;
+		chunks.push_back(c);
+		current = chunks.size() - 1;
+		used = n;
+		return c.base;
+	}
+
+	bool full() const {
+		return handedOut >= limit;
+	}
+
+	// everything handed out since the last reset is dead by now
+	void reset() {
+		MemoryStats::removeString(handedOut, live);
+		handedOut = 0;
+		live = 0;
+		stats.resets++;
+		current = 0;
+		used = 0;
+	}
+
+	// the arena that string operations on this thread allocate from, if any
+	static ExecArena *&active() {
+		static thread_local ExecArena *arena = nullptr;
+		return arena;
+	}
+
+	// makes an arena active for the lifetime of one execution and rewinds it
+	// when the execution is over
+	class Scope {
+		ExecArena *arena;
+		ExecArena *previous;
+
+	public:
+		Scope(ExecArena *arena) :
+				arena(arena), previous(active()) {
+			active() = arena;
+		}
+		~Scope() {
+			active() = previous;
+			if (arena) {
+				arena->reset();
+			}
+		}
+	};
+};
+
+// std allocator adapter so that shared_ptr control blocks and nodes can be
+// placed in an arena; deallocation is a no-op
+template<class T>
+struct ArenaAllocator {
+	typedef T value_type;
+
+	ExecArena *arena;
+
+	ArenaAllocator(ExecArena *arena) :
+			arena(arena) {
+	}
+	template<class U>
+	ArenaAllocator(const ArenaAllocator<U>& a) :
+			arena(a.arena) {
+	}
+
+	T *allocate(size_t n) {
+		return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T *, size_t) {
+	}
+
+	template<class U>
+	bool operator==(const ArenaAllocator<U>& a) const {
+		return arena == a.arena;
+	}
+	template<class U>
+	bool operator!=(const ArenaAllocator<U>& a) const {
+		return arena != a.arena;
+	}
+};
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,224 @@
+/*
+ * batch.h
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include "parse.h"
+#include "threadpool.h"
+#include "coop.h"
+using namespace std;
+
+// runs many script files on a thread pool, or as coroutines spread over a
+// few threads. Every script gets its own symbol table and its own output
+// buffers; the buffers are written out in input order as soon as the scripts
+// ahead of them are done, followed on stderr by a summary of throughput and
+// of the scripts that failed
+class BatchRunner {
+	struct Result {
+		string out;
+		string err;
+		// empty if the script ran to the end
+		string failure;
+		bool done;
+	};
+
+	vector<string> files;
+	ExecBudget::Limits limits;
+	vector<Result> results;
+	mutex lock;
+	condition_variable finished;
+
+public:
+	BatchRunner(const vector<string>& files, const ExecBudget::Limits& limits = ExecBudget::Limits()) :
+			files(files), limits(limits), results(files.size()) {
+	}
+
+	// file names one per line; blank lines are skipped
+	static bool readManifest(const string& name, vector<string>& files) {
+		ifstream manifest(name);
+		if (!manifest.is_open()) {
+			return false;
+		}
+		string line;
+		while (getline(manifest, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			if (!line.empty()) {
+				files.push_back(line);
+			}
+		}
+		return true;
+	}
+
+	// returns the number of scripts that failed
+	size_t run(size_t workers) {
+		auto start = chrono::steady_clock::now();
+		ThreadPool pool(workers);
+		for (size_t i = 0; i < files.size(); i++) {
+			pool.submit([this, i] {
+				execute(i);
+			});
+		}
+		size_t failed = collect();
+		pool.wait();
+		summarize(start, pool.size(), failed);
+		return failed;
+	}
+
+	// the same with every script a coroutine, dealt round robin to one
+	// scheduler per thread, that lets the others run whenever it has run
+	// statements of quantum nodes
+	size_t runCoroutines(size_t threads, size_t quantum) {
+		auto start = chrono::steady_clock::now();
+		threads = threads ? threads : 1;
+		vector<CoScheduler> schedulers(threads);
+		for (size_t i = 0; i < files.size(); i++) {
+			schedulers[i % threads].spawn(script(i, quantum));
+		}
+		vector<thread> pool;
+		for (CoScheduler& scheduler : schedulers) {
+			pool.emplace_back(&CoScheduler::run, &scheduler);
+		}
+		size_t failed = collect();
+		for (thread& t : pool) {
+			t.join();
+		}
+		summarize(start, threads, failed);
+		return failed;
+	}
+
+private:
+	// writes each script's output once it is done, in input order
+	size_t collect() {
+		size_t failed = 0;
+		OutputSink& out = OutputSink::standardOutput();
+		OutputSink& err = OutputSink::standardError();
+		for (size_t i = 0; i < files.size(); i++) {
+			Result& r = results[i];
+			{
+				unique_lock<mutex> guard(lock);
+				finished.wait(guard, [&r] {
+					return r.done;
+				});
+			}
+			out << r.out;
+			if (!r.err.empty()) {
+				out.flush();
+				err << r.err;
+				err.flush();
+			}
+			failed += !r.failure.empty();
+			// the buffers are not needed once written
+			r.out = string();
+			r.err = string();
+		}
+		out.flush();
+		return failed;
+	}
+
+	void summarize(chrono::steady_clock::time_point start, size_t threads, size_t failed) {
+		OutputSink& err = OutputSink::standardError();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		err << "BATCH SUMMARY: " << (long long) files.size() << " scripts in " << to_string(seconds) << "s ("
+				<< to_string(seconds > 0 ? files.size() / seconds : 0) << " scripts/s) on "
+				<< (long long) threads << " threads, " << (long long) failed << " failed\n";
+		for (size_t i = 0; i < files.size(); i++) {
+			if (!results[i].failure.empty()) {
+				err << files[i] << ": " << results[i].failure << '\n';
+			}
+		}
+		err.flush();
+	}
+
+	void execute(size_t i) {
+		static thread_local ExecArena arena;
+		Result& r = results[i];
+
+		OutputSink out, err;
+		OutputSink *previousOut = OutputSink::active();
+		OutputSink *previousErr = OutputSink::activeError();
+		OutputSink::active() = &out;
+		OutputSink::activeError() = &err;
+
+		ifstream file(files[i]);
+		if (!file.is_open()) {
+			err << "COULD NOT OPEN " << files[i] << '\n';
+			r.failure = "could not open";
+		}
+		else {
+			int line = 0;
+			ParseTree *prog = Prog(&file, &line);
+			if (prog == 0) {
+				r.failure = "parse error";
+			}
+			else {
+				SymbolTable symbols;
+				ExecBudget budget(limits);
+				ExecBudget::Scope scope(limits.any() ? &budget : 0);
+				prog->Run(&symbols, &arena);
+				delete prog;
+				ErrorState& state = ErrorState::current();
+				if (state.hasFailed()) {
+					r.failure = "runtime error at line " + to_string(state.getLine()) + ": " + state.getMessage();
+				}
+			}
+		}
+
+		OutputSink::active() = previousOut;
+		OutputSink::activeError() = previousErr;
+		finish(r, out, err);
+	}
+
+	CoTask script(size_t i, size_t quantum) {
+		Result& r = results[i];
+		OutputSink out, err;
+		ifstream file(files[i]);
+		if (!file.is_open()) {
+			err << "COULD NOT OPEN " << files[i] << '\n';
+			r.failure = "could not open";
+		}
+		else {
+			// parse errors are printed to the script's own output
+			OutputSink *previous = OutputSink::active();
+			OutputSink::active() = &out;
+			int line = 0;
+			ParseTree *prog = Prog(&file, &line);
+			OutputSink::active() = previous;
+			if (prog == 0) {
+				r.failure = "parse error";
+			}
+			else {
+				SymbolTable symbols;
+				ExecBudget budget(limits);
+				CoTask run = runCooperative(prog, &symbols, &out, &err, quantum, &r.failure,
+						limits.any() ? &budget : 0);
+				while (run.resume()) {
+					co_await suspend_always();
+				}
+				delete prog;
+			}
+		}
+		finish(r, out, err);
+	}
+
+	void finish(Result& r, OutputSink& out, OutputSink& err) {
+		{
+			lock_guard<mutex> guard(lock);
+			r.out = out.take();
+			r.err = err.take();
+			r.done = true;
+		}
+		finished.notify_all();
+	}
+};
+
+#endif /* BATCH_H_ */
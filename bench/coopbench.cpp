@@ -0,0 +1,88 @@
+/*
+ * coopbench.cpp
+ *
+ * cost of running scripts as coroutines: the bare resume and suspend of a
+ * CoTask, and 10k concurrent scripts round robin on one scheduler at several
+ * quanta, against running the same scripts one after the other
+ *
+ * usage: coopbench.exe [scripts] [statements per script]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include "../tokens.h"
+#include "../coop.h"
+using namespace std;
+
+static double seconds(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static CoTask spin(int yields) {
+	for (int i = 0; i < yields; i++) {
+		co_await suspend_always();
+	}
+}
+
+// x = 0; then x = x + 1; statements - 1 times
+static ParseTree *counter(int statements) {
+	Token x(IDENT, "x", 1);
+	ParseTree *list = 0;
+	for (int i = statements - 1; i > 0; i--) {
+		list = new StmtList(new Assignment(i, new Ident(x), new PlusExpr(i, new Ident(x), new IConst(i, 1))), list);
+	}
+	return new StmtList(new Assignment(0, new Ident(x), new IConst(0, 0)), list);
+}
+
+int main(int argc, char *argv[]) {
+	size_t scripts = argc > 1 ? atoi(argv[1]) : 10000;
+	int statements = argc > 2 ? atoi(argv[2]) : 100;
+
+	{
+		const int yields = 100;
+		CoScheduler scheduler;
+		for (size_t i = 0; i < scripts; i++) {
+			scheduler.spawn(spin(yields));
+		}
+		auto start = chrono::steady_clock::now();
+		scheduler.run();
+		double t = seconds(start);
+		cout << "bare switch: " << scheduler.getSwitches() << " resumes in " << t << "s, "
+				<< t * 1e9 / scheduler.getSwitches() << " ns each" << endl;
+	}
+
+	ParseTree *prog = counter(statements);
+	size_t nodes = 0;
+	for (ParseTree *l = prog; l != 0; l = l->right) {
+		nodes += l->left->NodeCount();
+	}
+
+	vector<SymbolTable> tables(scripts);
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < scripts; i++) {
+		prog->Run(&tables[i]);
+	}
+	double sequential = seconds(start);
+	cout << scripts << " scripts of " << statements << " statements one after the other: " << sequential << "s, "
+			<< scripts / sequential << " scripts/s" << endl;
+
+	size_t quanta[] = { 1, 16, 256, nodes };
+	for (size_t quantum : quanta) {
+		vector<SymbolTable> tables(scripts);
+		vector<string> failures(scripts);
+		OutputSink out, err;
+		CoScheduler scheduler;
+		for (size_t i = 0; i < scripts; i++) {
+			scheduler.spawn(runCooperative(prog, &tables[i], &out, &err, quantum, &failures[i]));
+		}
+		auto start = chrono::steady_clock::now();
+		scheduler.run();
+		double t = seconds(start);
+		long long check = tables[scripts - 1]["x"].getInteger();
+		cout << "quantum " << quantum << " nodes: " << scheduler.getSwitches() << " resumes, " << t << "s, "
+				<< scripts / t << " scripts/s, " << (t / sequential - 1) * 100 << "% over one after the other (x = "
+				<< check << ")" << endl;
+	}
+	delete prog;
+	return 0;
+}
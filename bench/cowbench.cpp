@@ -0,0 +1,58 @@
+/*
+ * cowbench.cpp
+ *
+ * times reading large string variables in a hot path: Ident lookups and the
+ * Values passed back up through if and statement list nodes
+ */
+
+#include <chrono>
+#include "../tokens.h"
+#include "../parsetree.h"
+using namespace std;
+
+static double seconds(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void readBench(size_t size, int reads) {
+	SymbolTable symbolTable;
+	symbolTable["s"] = Value(string(size, 'x'));
+
+	Token id(IDENT, "s", 1);
+	Token tr(TRUE, "true", 1);
+	ParseTree *read = new Ident(id);
+	ParseTree *stmt = new StmtList(new IfStatement(1, new BoolConst(tr, true), new Ident(id)), 0);
+
+	size_t total = 0;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < reads; i++) {
+		total += read->Eval(&symbolTable).getString().size();
+	}
+	double ident = seconds(start);
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < reads; i++) {
+		total += stmt->Eval(&symbolTable).isTrue();
+	}
+	double passed = seconds(start);
+
+	start = chrono::steady_clock::now();
+	string_view raw = symbolTable["s"].getString();
+	for (int i = 0; i < reads; i++) {
+		string copy(raw);
+		total += copy.size();
+	}
+	double copies = seconds(start);
+
+	cout << "size=" << size << " ident " << ident * 1e9 / reads << "ns/read  if+slist " << passed * 1e9 / reads
+			<< "ns/stmt  string copy " << copies * 1e9 / reads << "ns/copy (" << total % 7 << ")" << endl;
+	delete read;
+	delete stmt;
+}
+
+int main(int argc, char *argv[]) {
+	for (size_t size = 64; size <= 1024 * 1024; size *= 16) {
+		readBench(size, 1000000);
+	}
+	return 0;
+}
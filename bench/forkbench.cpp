@@ -0,0 +1,179 @@
+/*
+ * forkbench.cpp
+ *
+ * time to first output of a small script that needs a large prelude: a cold
+ * start runs the interpreter with --prelude for every script, a warm start
+ * sends the script to a --fork-serve daemon that ran the prelude once. The
+ * prelude assigns constants and lookup strings; the script prints one of each
+ *
+ * usage: forkbench.exe interpreter [prelude assignments] [runs]
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <spawn.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+using namespace std;
+
+extern char **environ;
+
+static double micros(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+// reads fd to the end; returns the time the first byte arrived
+static double drain(int fd, chrono::steady_clock::time_point start, string& all) {
+	double first = -1;
+	char buf[64 * 1024];
+	ssize_t n;
+	while ((n = read(fd, buf, sizeof buf)) > 0) {
+		if (first < 0) {
+			first = micros(start);
+		}
+		all.append(buf, n);
+	}
+	return first;
+}
+
+static pid_t spawn(const vector<string>& args, int out) {
+	vector<char *> argv;
+	for (const string& a : args) {
+		argv.push_back((char *) a.c_str());
+	}
+	argv.push_back(0);
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (out >= 0) {
+		posix_spawn_file_actions_adddup2(&actions, out, STDOUT_FILENO);
+	}
+	pid_t pid;
+	int r = posix_spawn(&pid, argv[0], &actions, 0, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	return r == 0 ? pid : -1;
+}
+
+static double cold(const string& interpreter, const string& prelude, const string& script, string& output) {
+	int pipes[2];
+	if (pipe(pipes) < 0) {
+		return -1;
+	}
+	auto start = chrono::steady_clock::now();
+	pid_t pid = spawn( { interpreter, "--prelude", prelude, script }, pipes[1]);
+	close(pipes[1]);
+	double first = drain(pipes[0], start, output);
+	close(pipes[0]);
+	waitpid(pid, 0, 0);
+	return pid < 0 ? -1 : first;
+}
+
+static double warm(const sockaddr_un& addr, const string& script, string& reply) {
+	auto start = chrono::steady_clock::now();
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (const sockaddr *) &addr, sizeof addr) < 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	string message = "\n" + script;
+	if (send(fd, message.data(), message.size(), MSG_NOSIGNAL) != (ssize_t) message.size()
+			|| shutdown(fd, SHUT_WR) < 0) {
+		close(fd);
+		return -1;
+	}
+	double first = drain(fd, start, reply);
+	close(fd);
+	return first;
+}
+
+static void report(const char *name, vector<double>& t) {
+	sort(t.begin(), t.end());
+	cout << name << ": p50 " << t[t.size() / 2] << "us, p99 " << t[t.size() * 99 / 100] << "us, min " << t[0] << "us"
+			<< endl;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		cerr << "usage: " << argv[0] << " interpreter [prelude assignments] [runs]" << endl;
+		return 1;
+	}
+	string interpreter = argv[1];
+	int assignments = argc > 2 ? atoi(argv[2]) : 5000;
+	int runs = argc > 3 ? atoi(argv[3]) : 200;
+
+	string dir = "/tmp/forkbench." + to_string(getpid());
+	string prelude = dir + ".prelude", script = dir + ".script", socketPath = dir + ".sock";
+	{
+		ofstream p(prelude);
+		for (int i = 0; i < assignments; i++) {
+			if (i % 2 == 0) {
+				p << "k" << i << " = " << i * 7919LL << " * 31 + " << i << ";\n";
+			}
+			else {
+				p << "s" << i << " = \"lookup-" << i << "\" + \"-" << i * 3 << "\";\n";
+			}
+		}
+		ofstream s(script);
+		s << "print(k0 + k" << (assignments / 2) * 2 - 2 << ");\nprint(s" << assignments - 1 << ");\n";
+	}
+	string source;
+	{
+		ifstream s(script);
+		getline(s, source, '\0');
+	}
+
+	pid_t daemon = spawn( { interpreter, "--fork-serve", socketPath, "--prelude", prelude }, -1);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof addr.sun_path - 1);
+	string reply;
+	auto start = chrono::steady_clock::now();
+	while (daemon > 0 && warm(addr, source, reply) < 0 && micros(start) < 10e6) {
+		usleep(1000);
+	}
+	cout << "daemon ready after " << micros(start) / 1000 << "ms, first reply:" << endl << reply;
+
+	string output;
+	cold(interpreter, prelude, script, output);
+	cout << "cold output:" << endl << output;
+
+	vector<double> coldTimes, warmTimes;
+	for (int i = 0; i < runs; i++) {
+		output.clear();
+		reply.clear();
+		double c = cold(interpreter, prelude, script, output);
+		double w = warm(addr, source, reply);
+		if (c < 0 || w < 0) {
+			cerr << "run " << i << " failed" << endl;
+			break;
+		}
+		coldTimes.push_back(c);
+		warmTimes.push_back(w);
+	}
+
+	if (daemon > 0) {
+		kill(daemon, SIGTERM);
+		waitpid(daemon, 0, 0);
+	}
+	unlink(prelude.c_str());
+	unlink(script.c_str());
+	unlink(socketPath.c_str());
+	if (coldTimes.empty()) {
+		return 1;
+	}
+	cout << assignments << " prelude assignments, " << coldTimes.size() << " runs, time to first output" << endl;
+	report("cold start", coldTimes);
+	report("fork server", warmTimes);
+	return 0;
+}
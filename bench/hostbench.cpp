@@ -0,0 +1,118 @@
+/*
+ * hostbench.cpp
+ *
+ * per-call cost of running a small script through the library's host API,
+ * parsing it every call, through a program cache, and parsed once, against
+ * spawning the interpreter executable for every run
+ *
+ * usage: hostbench.exe interpreter [calls] [spawns]
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../interp.h"
+#include "../progcache.h"
+using namespace std;
+
+extern char **environ;
+
+static const char *SCRIPT = "total = price * quantity;\n"
+		"if total > 1000 then discount = total / 10;\n"
+		"label = \"order \" + name;\n"
+		"print(label);\n";
+
+static double seconds(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *name, int calls, double t) {
+	cout << name << ": " << t * 1e6 / calls << "us per call, " << calls / t << " calls/s" << endl;
+}
+
+// the inputs every call starts from
+static void inputs(Session& session, long long i) {
+	session.set("price", Value(i % 100 + 1));
+	session.set("quantity", Value(i % 37 + 1));
+	session.set("name", Value(string("alice")));
+	session.set("discount", Value());
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		cerr << "usage: " << argv[0] << " interpreter [calls] [spawns]" << endl;
+		return 1;
+	}
+	string interpreter = argv[1];
+	int calls = argc > 2 ? atoi(argv[2]) : 100000;
+	int spawns = argc > 3 ? atoi(argv[3]) : 300;
+
+	string source = SCRIPT;
+	size_t printed = 0;
+	Session::Output output = [&printed](string_view s) {
+		printed += s.size();
+	};
+	Session session;
+	ScriptError error;
+
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < calls; i++) {
+		Program prog = Program::parse(source);
+		inputs(session, i);
+		session.run(prog, output, &error);
+	}
+	report("parse and run", calls, seconds(start));
+
+	ProgramCache cache(1024 * 1024);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < calls; i++) {
+		Program prog = Program::parse(source, 0, &cache);
+		inputs(session, i);
+		session.run(prog, output, &error);
+	}
+	report("cached parse and run", calls, seconds(start));
+
+	Program prog = Program::parse(source);
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < calls; i++) {
+		inputs(session, i);
+		session.run(prog, output, &error);
+	}
+	report("run a parsed program", calls, seconds(start));
+	cout << "last total " << session.get("total") << ", " << printed << " bytes printed" << endl;
+
+	// the executable has no way in for inputs, so they go at the top
+	string path = "/tmp/hostbench." + to_string(getpid()) + ".txt";
+	{
+		ofstream f(path);
+		f << "price = 12;\nquantity = 150;\nname = \"alice\";\n" << SCRIPT;
+	}
+	char *args[] = { (char *) interpreter.c_str(), (char *) path.c_str(), 0 };
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+	start = chrono::steady_clock::now();
+	int spawned = 0;
+	for (; spawned < spawns; spawned++) {
+		pid_t pid;
+		int status;
+		if (posix_spawn(&pid, args[0], &actions, 0, args, environ) != 0 || waitpid(pid, &status, 0) < 0
+				|| !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			cerr << "could not run " << interpreter << endl;
+			break;
+		}
+	}
+	double t = seconds(start);
+	posix_spawn_file_actions_destroy(&actions);
+	unlink(path.c_str());
+	if (spawned > 0) {
+		report("spawn the executable", spawned, t);
+	}
+	return 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * intbench.cpp
+ *
+ * integer arithmetic throughput through the parse tree: the small-int fast
+ * path, the overflow path that promotes to BigInt, and for comparison the
+ * same expression through a copy of the 32-bit Value and nodes the
+ * interpreter had before integers were widened
+ */
+
+#include <ctime>
+#include <map>
+#include <string>
+#include "../tokens.h"
+#include "../parsetree.h"
+using namespace std;
+
+// the int paths of the 32-bit interpreter, as they were: a Value of bool,
+// int and string, errors returned as Values and checked by every parent
+namespace int32 {
+
+class Value {
+	bool bval;
+	int ival;
+	string sval;
+	enum VT {
+		isBool, isInt, isString, isTypeError
+	} type;
+
+public:
+	Value(bool bval) :
+			bval(bval), ival(0), type(isBool) {
+	}
+	Value(int ival) :
+			bval(false), ival(ival), type(isInt) {
+	}
+	Value(string sval, bool isError) :
+			bval(false), ival(0), sval(sval), type(isTypeError) {
+	}
+
+	bool isError() const {
+		return type == VT::isTypeError;
+	}
+	bool isTrue() const {
+		return type == VT::isBool && bval;
+	}
+
+	Value operator+(const Value& v) {
+		return areInts(v) ? Value(ival + v.ival) : Value("Invalid operands for +", true);
+	}
+	Value operator-(const Value& v) {
+		return areInts(v) ? Value(ival - v.ival) : Value("Invalid operands for -", true);
+	}
+	Value operator*(const Value& v) {
+		return areInts(v) ? Value(ival * v.ival) : Value("Invalid operands for *", true);
+	}
+	Value operator/(const Value& v) {
+		if (v.ival == 0) {
+			return Value("Division by 0", true);
+		}
+		return areInts(v) ? Value(ival / v.ival) : Value("Invalid operands for /", true);
+	}
+	Value operator<(const Value& v) {
+		return areInts(v) ? Value(ival < v.ival) : Value("Invalid operands for <", true);
+	}
+
+private:
+	bool areInts(const Value& v) const {
+		return type == VT::isInt && v.type == VT::isInt;
+	}
+};
+
+typedef map<string, Value> SymbolTable;
+
+struct Node {
+	Node *left;
+	Node *right;
+
+	Node(Node *l = 0, Node *r = 0) :
+			left(l), right(r) {
+	}
+	virtual ~Node() {
+		delete left;
+		delete right;
+	}
+	virtual Value Eval(SymbolTable *symbolTable) const = 0;
+};
+
+template<char Op>
+struct Binary: Node {
+	Binary(Node *l, Node *r) :
+			Node(l, r) {
+	}
+	Value Eval(SymbolTable *symbolTable) const override {
+		Value l = left->Eval(symbolTable);
+		if (l.isError()) {
+			return l;
+		}
+		Value r = right->Eval(symbolTable);
+		if (r.isError()) {
+			return r;
+		}
+		switch (Op) {
+		case '+':
+			return l + r;
+		case '-':
+			return l - r;
+		case '*':
+			return l * r;
+		case '/':
+			return l / r;
+		default:
+			return l < r;
+		}
+	}
+};
+
+struct IConst: Node {
+	Value val;
+
+	IConst(int i) :
+			val(i) {
+	}
+	Value Eval(SymbolTable *symbolTable) const override {
+		return val;
+	}
+};
+
+struct Ident: Node {
+	string id;
+
+	Ident(const string& id) :
+			id(id) {
+	}
+	Value Eval(SymbolTable *symbolTable) const override {
+		if (symbolTable->find(id) == symbolTable->end()) {
+			return Value("Identifier not found", true);
+		}
+		return symbolTable->find(id)->second;
+	}
+};
+
+}
+
+// best of several runs in cpu time, since the machine may be shared
+static double best(ParseTree *tree, SymbolTable *symbolTable, int n, long& sink) {
+	double fastest = 1e9;
+	for (int run = 0; run < 7; run++) {
+		clock_t start = clock();
+		for (int i = 0; i < n; i++) {
+			sink += tree->Eval(symbolTable).isTrue();
+		}
+		fastest = min(fastest, double(clock() - start) / CLOCKS_PER_SEC);
+	}
+	return fastest;
+}
+
+static double best(int32::Node *tree, int32::SymbolTable *symbolTable, int n, long& sink) {
+	double fastest = 1e9;
+	for (int run = 0; run < 7; run++) {
+		clock_t start = clock();
+		for (int i = 0; i < n; i++) {
+			sink += tree->Eval(symbolTable).isTrue();
+		}
+		fastest = min(fastest, double(clock() - start) / CLOCKS_PER_SEC);
+	}
+	return fastest;
+}
+
+// (a * 3 + 7 - 1) / 3 < 1000, eleven nodes
+static ParseTree *expression(Token& a) {
+	ParseTree *sum = new PlusExpr(1, new TimesExpr(1, new Ident(a), new IConst(1, 3)), new IConst(1, 7));
+	ParseTree *quotient = new DivideExpr(1, new MinusExpr(1, sum, new IConst(1, 1)), new IConst(1, 3));
+	return new LtExpr(1, quotient, new IConst(1, 1000));
+}
+
+// the same expression in the 32-bit nodes
+static int32::Node *expression32() {
+	using namespace int32;
+	Node *sum = new Binary<'+'>(new Binary<'*'>(new int32::Ident("a"), new int32::IConst(3)), new int32::IConst(7));
+	Node *quotient = new Binary<'/'>(new Binary<'-'>(sum, new int32::IConst(1)), new int32::IConst(3));
+	return new Binary<'<'>(quotient, new int32::IConst(1000));
+}
+
+int main(int argc, char *argv[]) {
+	const int n = 2000000;
+	long sink = 0;
+	Token a(IDENT, "a", 1);
+	ParseTree *tree = expression(a);
+	SymbolTable symbolTable;
+
+	int32::Node *tree32 = expression32();
+	int32::SymbolTable symbolTable32;
+	symbolTable32.emplace("a", int32::Value(12345));
+	double t = best(tree32, &symbolTable32, n, sink);
+	cout << "32-bit ints " << n * 11 / t / 1e6 << " Mnodes/s" << endl;
+	delete tree32;
+
+	symbolTable["a"] = Value(12345);
+	t = best(tree, &symbolTable, n, sink);
+	cout << "small ints  " << n * 11 / t / 1e6 << " Mnodes/s" << endl;
+
+	symbolTable["a"] = Value(BigInt::fromString("123456789012345678901234567890"));
+	t = best(tree, &symbolTable, n / 100, sink);
+	cout << "big ints    " << n / 100 * 11 / t / 1e6 << " Mnodes/s (" << sink << ")" << endl;
+
+	delete tree;
+	return 0;
+}
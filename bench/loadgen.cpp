@@ -0,0 +1,127 @@
+/*
+ * loadgen.cpp
+ *
+ * load generator for the --serve daemon: several client threads send the same
+ * script over and over and the run reports requests per second and the
+ * p50/p99 latency of a request
+ *
+ * usage: loadgen.exe socket script [clients] [requests per client] [table]
+ */
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+using namespace std;
+
+static atomic<int> failures(0);
+
+static bool sendAll(int fd, const string& s) {
+	size_t done = 0;
+	while (done < s.size()) {
+		ssize_t n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+// sends one request and reads the reply up to its end frame
+static bool request(const sockaddr_un& addr, const string& message, string& reply) {
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (const sockaddr *) &addr, sizeof addr) < 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+	bool ok = sendAll(fd, message) && shutdown(fd, SHUT_WR) == 0;
+	reply.clear();
+	char buf[64 * 1024];
+	ssize_t n;
+	while (ok && (n = read(fd, buf, sizeof buf)) > 0) {
+		reply.append(buf, n);
+	}
+	close(fd);
+	return ok && reply.size() >= 4 && reply.compare(reply.size() - 4, 4, "x 0\n") == 0;
+}
+
+static void client(const sockaddr_un& addr, const string& message, int requests, vector<double>& latencies) {
+	string reply;
+	for (int i = 0; i < requests; i++) {
+		auto start = chrono::steady_clock::now();
+		if (!request(addr, message, reply)) {
+			failures++;
+			continue;
+		}
+		latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		cerr << "usage: " << argv[0] << " socket script [clients] [requests per client] [table]" << endl;
+		return 1;
+	}
+	ifstream file(argv[2]);
+	if (!file.is_open()) {
+		cerr << "COULD NOT OPEN " << argv[2] << endl;
+		return 1;
+	}
+	stringstream script;
+	script << file.rdbuf();
+	int clients = argc > 3 ? atoi(argv[3]) : 4;
+	int requests = argc > 4 ? atoi(argv[4]) : 1000;
+	string table = argc > 5 ? argv[5] : "";
+	string message = table + "\n" + script.str();
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, argv[1], sizeof addr.sun_path - 1);
+
+	// one request first, so that the output can be checked by eye
+	string reply;
+	if (!request(addr, message, reply)) {
+		cerr << "no reply from " << argv[1] << endl;
+		return 1;
+	}
+	cout << "first reply:" << endl << reply;
+
+	vector<vector<double>> latencies(clients);
+	vector<thread> threads;
+	auto start = chrono::steady_clock::now();
+	for (int c = 0; c < clients; c++) {
+		threads.emplace_back(client, cref(addr), cref(message), requests, ref(latencies[c]));
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	vector<double> all;
+	for (vector<double>& l : latencies) {
+		all.insert(all.end(), l.begin(), l.end());
+	}
+	sort(all.begin(), all.end());
+	if (all.empty()) {
+		cerr << "every request failed" << endl;
+		return 1;
+	}
+	cout << clients << " clients, " << all.size() << " requests in " << elapsed << "s: " << all.size() / elapsed
+			<< " req/s, p50 " << all[all.size() / 2] << "us, p99 " << all[all.size() * 99 / 100] << "us, "
+			<< failures << " failed" << endl;
+	return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * ropebench.cpp
+ *
+ * times repeated string append and large string repetition through Value
+ */
+
+#include <chrono>
+#include "../value.h"
+using namespace std;
+
+static double seconds(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void appendBench(int n) {
+	auto start = chrono::steady_clock::now();
+	Value s = Value(string(""));
+	Value x = Value(string("x"));
+	for (int i = 0; i < n; i++) {
+		s = s + x;
+	}
+	double build = seconds(start);
+	start = chrono::steady_clock::now();
+	size_t len = s.getString().size();
+	double flat = seconds(start);
+	cout << "append      n=" << n << " len=" << len << " build " << build << "s flatten " << flat << "s" << endl;
+}
+
+static void repeatBench(int n) {
+	auto start = chrono::steady_clock::now();
+	Value s = Value(string("ab")) * Value(n);
+	double build = seconds(start);
+	start = chrono::steady_clock::now();
+	Value same = s == s * Value(1);
+	size_t len = s.getString().size();
+	double flat = seconds(start);
+	cout << "repeat      n=" << n << " len=" << len << " build " << build << "s flatten " << flat << "s " << same
+			<< endl;
+}
+
+int main(int argc, char *argv[]) {
+	for (int n = 1000; n <= 1000000; n *= 10) {
+		appendBench(n);
+	}
+	for (int n = 1000; n <= 100000000; n *= 100) {
+		repeatBench(n);
+	}
+	return 0;
+}
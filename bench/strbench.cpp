@@ -0,0 +1,108 @@
+/*
+ * strbench.cpp
+ *
+ * times the string kernels against the std::string operations they replace,
+ * for strings from 8 B to 64 MB, and the same operations through Value
+ */
+
+#include <chrono>
+#include <cstdio>
+#include "../value.h"
+#include "../strkernels.h"
+using namespace std;
+
+// keeps the optimizer from dropping the timed loops
+static volatile long long sink;
+
+// best of five runs of f, in nanoseconds per call
+template<class F>
+static double time(size_t reps, F f) {
+	double best = 1e300;
+	for (int run = 0; run < 5; run++) {
+		auto start = chrono::steady_clock::now();
+		for (size_t i = 0; i < reps; i++) {
+			sink = sink + f();
+		}
+		double t = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / reps;
+		best = min(best, t);
+	}
+	return best;
+}
+
+static string sizeName(size_t n) {
+	char buf[32];
+	if (n >= 1024 * 1024) {
+		snprintf(buf, sizeof buf, "%zuM", n / (1024 * 1024));
+	}
+	else if (n >= 1024) {
+		snprintf(buf, sizeof buf, "%zuK", n / 1024);
+	}
+	else {
+		snprintf(buf, sizeof buf, "%zu", n);
+	}
+	return buf;
+}
+
+static double gbs(size_t bytes, double ns) {
+	return bytes / ns;
+}
+
+int main(int argc, char *argv[]) {
+	printf("%-6s %12s %12s %12s %12s %12s %12s %12s\n", "size", "eq std", "eq kernel", "cmp std", "cmp kernel",
+			"rep append", "rep double", "Value ==");
+	printf("%-6s %12s %12s %12s %12s %12s %12s %12s\n", "", "GB/s", "GB/s", "GB/s", "GB/s", "GB/s", "GB/s", "GB/s");
+
+	const size_t sizes[] = { 8, 64, 512, 4 << 10, 32 << 10, 256 << 10, 2 << 20, 16 << 20, 64 << 20 };
+	for (size_t n : sizes) {
+		// about 256 MB of traffic per measurement
+		size_t reps = max<size_t>(1, (size_t(256) << 20) / n);
+
+		string a(n, 'x');
+		string b(a);
+		// differs only in the last byte so the scans run to the end
+		string c(a);
+		c[n - 1] = 'y';
+
+		double eqStd = time(reps, [&] {
+			return a == b;
+		});
+		double eqKernel = time(reps, [&] {
+			return StrKernels::equal(a.data(), a.size(), b.data(), b.size());
+		});
+		double cmpStd = time(reps, [&] {
+			return a.compare(c);
+		});
+		double cmpKernel = time(reps, [&] {
+			return StrKernels::compare(a.data(), a.size(), c.data(), c.size());
+		});
+
+		string piece("abc");
+		size_t copies = n / piece.size() ? n / piece.size() : 1;
+		size_t repReps = max<size_t>(1, reps / 4);
+		double repAppend = time(repReps, [&] {
+			string out;
+			out.reserve(piece.size() * copies);
+			for (size_t i = 0; i < copies; i++) {
+				out.append(piece);
+			}
+			return (long long) out.size();
+		});
+		double repDouble = time(repReps, [&] {
+			string out(piece.size() * copies, '\0');
+			StrKernels::repeat(&out[0], piece.data(), piece.size(), copies);
+			return (long long) out.size();
+		});
+
+		Value va = Value(a);
+		Value vb = Value(b);
+		double eqValue = time(reps, [&] {
+			return (va == vb).getBoolean();
+		});
+
+		size_t rep = piece.size() * copies;
+		printf("%-6s %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n", sizeName(n).c_str(), gbs(n, eqStd),
+				gbs(n, eqKernel), gbs(n, cmpStd), gbs(n, cmpKernel), gbs(rep, repAppend), gbs(rep, repDouble),
+				gbs(n, eqValue));
+	}
+	return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * suite.cpp
+ *
+ * the regression suite: generated sources for representative workloads, each
+ * timed through the lexer alone, the parser (which lexes as it goes) and the
+ * evaluator. Results are tab separated, one line per workload and phase,
+ * with the rate in units per second: tokens for lex and parse, parse tree
+ * nodes for eval. compare reads two result files and flags every rate that
+ * dropped by more than the tolerance, exiting 1 if there is one
+ *
+ * usage: suite.exe run [statements]
+ *        suite.exe compare baseline current [tolerance percent]
+ */
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include "../interp.h"
+#include "../parse.h"
+using namespace std;
+
+// each phase is repeated for at least this long and the best time is kept
+static const double MIN_SECONDS = 0.3;
+static const int MIN_REPEATS = 3;
+
+struct Workload {
+	const char *name;
+	string (*generate)(int statements);
+};
+
+static string ints(int statements) {
+	ostringstream s;
+	s << "a = 1;\nb = 2;\nc = 3;\n";
+	for (int i = 0; i < statements; i++) {
+		s << "v" << i % 64 << " = a * " << i % 97 << " + b * c - " << i % 13 << " / c + (a - b) * 7;\n";
+	}
+	return s.str();
+}
+
+static string nested(int statements) {
+	const int depth = 64;
+	ostringstream s;
+	s << "x = 0;\n";
+	for (int i = 0; i < statements / 8; i++) {
+		s << "x = ";
+		for (int d = 0; d < depth; d++) {
+			s << '(';
+		}
+		s << 'x';
+		for (int d = 0; d < depth; d++) {
+			s << (d % 2 ? " - " : " + ") << d % 5 << ')';
+		}
+		s << ";\n";
+	}
+	return s.str();
+}
+
+static string strings(int statements) {
+	ostringstream s;
+	for (int i = 0; i < statements; i++) {
+		switch (i % 4) {
+		case 0:
+			s << "s = \"row " << i << " \";\n";
+			break;
+		case 1:
+			s << "t = \"ab\" * " << 8 + i % 32 << ";\n";
+			break;
+		case 2:
+			s << "s = s + t + \"|\";\n";
+			break;
+		default:
+			s << "u = s + s;\n";
+		}
+	}
+	return s.str();
+}
+
+// each value is the mean of two earlier ones, so all of them stay within
+// 0..1000 and the time goes to looking up and assigning names, not BigInts
+static string identifiers(int statements) {
+	ostringstream s;
+	s << "identifier0 = 1000;\n";
+	for (int i = 1; i < statements; i++) {
+		s << "identifier" << i << " = (identifier" << i - 1 << " + identifier" << i / 2 << ") / 2;\n";
+	}
+	return s.str();
+}
+
+static string comments(int statements) {
+	ostringstream s;
+	s << "x = 0;\n";
+	for (int i = 0; i < statements; i++) {
+		s << "# " << string(100, i % 2 ? '-' : '=') << " comment " << i << "\n";
+		s << "\t\t  \n   x   =   x   +   " << i % 10 << "   ;  \t\n\n";
+	}
+	return s.str();
+}
+
+static string prints(int statements) {
+	ostringstream s;
+	for (int i = 0; i < statements; i++) {
+		s << "print(" << i << ");\n";
+	}
+	return s.str();
+}
+
+static double seconds(chrono::steady_clock::time_point start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// best time of f over repeats that together take at least MIN_SECONDS
+template<typename F> static double best(F f) {
+	double fastest = 1e30, total = 0;
+	for (int i = 0; i < MIN_REPEATS || total < MIN_SECONDS; i++) {
+		auto start = chrono::steady_clock::now();
+		f();
+		double t = seconds(start);
+		fastest = min(fastest, t);
+		total += t;
+	}
+	return fastest;
+}
+
+static void result(const char *workload, const char *phase, size_t units, double t) {
+	cout << workload << '\t' << phase << '\t' << units << '\t' << t << '\t' << (long long) (units / t) << endl;
+}
+
+static int run(int statements) {
+	Workload workloads[] = { { "ints", ints }, { "nested", nested }, { "strings", strings }, { "identifiers",
+			identifiers }, { "comments", comments }, { "prints", prints } };
+	cout << "workload\tphase\tunits\tseconds\trate" << endl;
+	for (Workload& w : workloads) {
+		string source = w.generate(statements);
+
+		size_t tokens = 0;
+		double lex = best([&] {
+			istringstream in(source);
+			int line = 0;
+			tokens = 0;
+			while (getNextToken(&in, &line) != DONE) {
+				tokens++;
+			}
+		});
+		result(w.name, "lex", tokens, lex);
+
+		vector<ScriptError> errors;
+		Program prog = Program::parse(source, &errors);
+		if (!prog.valid()) {
+			cerr << w.name << ": " << errors[0].line << ": " << errors[0].message << endl;
+			return 1;
+		}
+		result(w.name, "parse", tokens, best([&] {
+			Program::parse(source);
+		}));
+
+		size_t printed = 0;
+		Session::Output output = [&printed](string_view s) {
+			printed += s.size();
+		};
+		double eval = best([&] {
+			Session session;
+			ScriptError error;
+			if (!session.run(prog, output, &error)) {
+				cerr << w.name << ": " << error.line << ": RUNTIME ERROR " << error.message << endl;
+				exit(1);
+			}
+		});
+		result(w.name, "eval", prog.getTree()->NodeCount(), eval);
+	}
+	return 0;
+}
+
+// workload and phase to rate
+static bool readResults(const char *path, map<string, double>& rates) {
+	ifstream in(path);
+	if (!in.is_open()) {
+		cerr << "COULD NOT OPEN " << path << endl;
+		return false;
+	}
+	string line;
+	getline(in, line);
+	while (getline(in, line)) {
+		istringstream fields(line);
+		string workload, phase;
+		double units, t, rate;
+		if (fields >> workload >> phase >> units >> t >> rate) {
+			rates[workload + " " + phase] = rate;
+		}
+	}
+	return true;
+}
+
+static int compare(const char *baselinePath, const char *currentPath, double tolerance) {
+	map<string, double> baseline, current;
+	if (!readResults(baselinePath, baseline) || !readResults(currentPath, current)) {
+		return 2;
+	}
+	int regressions = 0;
+	for (const pair<const string, double>& b : baseline) {
+		map<string, double>::iterator c = current.find(b.first);
+		if (c == current.end()) {
+			cout << b.first << "\tMISSING" << endl;
+			regressions++;
+			continue;
+		}
+		double change = (c->second / b.second - 1) * 100;
+		bool regressed = change < -tolerance;
+		regressions += regressed;
+		cout << b.first << '\t' << (long long) b.second << " -> " << (long long) c->second << '\t'
+				<< (change >= 0 ? "+" : "") << change << '%' << (regressed ? "\tREGRESSION" : "") << endl;
+	}
+	cout << regressions << " regressions beyond " << tolerance << '%' << endl;
+	return regressions ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+	string command = argc > 1 ? argv[1] : "run";
+	if (command == "run") {
+		return run(argc > 2 ? atoi(argv[2]) : 10000);
+	}
+	if (command == "compare" && argc > 3) {
+		return compare(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 10);
+	}
+	cerr << "usage: " << argv[0] << " run [statements]" << endl;
+	cerr << "       " << argv[0] << " compare baseline current [tolerance percent]" << endl;
+	return 2;
+}
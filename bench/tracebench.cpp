@@ -0,0 +1,54 @@
+/*
+ * tracebench.cpp
+ *
+ * per-statement cost of the trace points: run a program of simple
+ * assignments with tracing off, then on. Built twice, as tracebench.exe with
+ * the trace points in and as notracebench.exe with INTERP_NO_TRACE, so that
+ * the first line of the two can be compared for the cost of the disabled
+ * points
+ *
+ * usage: tracebench.exe [statements] [runs]
+ */
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include "../interp.h"
+using namespace std;
+
+// the best time of runs runs, in nanoseconds per statement
+static double perStatement(Session& session, const Program& prog, int statements, int runs) {
+	Session::Output output = [](string_view) {
+	};
+	double best = 1e30;
+	for (int i = 0; i < runs; i++) {
+		auto start = chrono::steady_clock::now();
+		session.run(prog, output, 0);
+		best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	}
+	return best * 1e9 / statements;
+}
+
+int main(int argc, char *argv[]) {
+	int statements = argc > 1 ? atoi(argv[1]) : 20000;
+	int runs = argc > 2 ? atoi(argv[2]) : 200;
+
+	ostringstream s;
+	for (int i = 0; i < statements; i++) {
+		s << "x" << i % 16 << " = " << i % 7 << " + " << i % 5 << ";\n";
+	}
+	Program prog = Program::parse(s.str());
+	Session session;
+
+#ifdef INTERP_NO_TRACE
+	cout << "compiled out: " << perStatement(session, prog, statements, runs) << "ns per statement" << endl;
+#else
+	cout << "disabled: " << perStatement(session, prog, statements, runs) << "ns per statement" << endl;
+	// one ring large enough that every run stays in it
+	Trace::enable(4 * statements);
+	cout << "enabled: " << perStatement(session, prog, statements, runs) << "ns per statement" << endl;
+#endif
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * bigint.h
+ */
+
+#ifndef BIGINT_H_
+#define BIGINT_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <climits>
+using namespace std;
+
+// arbitrary precision integer, used only once a 64-bit value overflows.
+// The magnitude is stored little endian in base 10^9 limbs
+class BigInt {
+	static const uint32_t BASE = 1000000000;
+
+	bool neg;
+	vector<uint32_t> mag;
+
+	void trim() {
+		while (!mag.empty() && mag.back() == 0) {
+			mag.pop_back();
+		}
+		if (mag.empty()) {
+			neg = false;
+		}
+	}
+
+	static int compareMag(const vector<uint32_t>& a, const vector<uint32_t>& b) {
+		if (a.size() != b.size()) {
+			return a.size() < b.size() ? -1 : 1;
+		}
+		for (size_t i = a.size(); i-- > 0;) {
+			if (a[i] != b[i]) {
+				return a[i] < b[i] ? -1 : 1;
+			}
+		}
+		return 0;
+	}
+
+	static vector<uint32_t> addMag(const vector<uint32_t>& a, const vector<uint32_t>& b) {
+		vector<uint32_t> r;
+		uint32_t carry = 0;
+		for (size_t i = 0; i < max(a.size(), b.size()) || carry; i++) {
+			uint32_t d = carry + (i < a.size() ? a[i] : 0) + (i < b.size() ? b[i] : 0);
+			carry = d >= BASE;
+			r.push_back(carry ? d - BASE : d);
+		}
+		return r;
+	}
+
+	// a - b where |a| >= |b|
+	static vector<uint32_t> subMag(const vector<uint32_t>& a, const vector<uint32_t>& b) {
+		vector<uint32_t> r(a);
+		int64_t borrow = 0;
+		for (size_t i = 0; i < r.size(); i++) {
+			int64_t d = int64_t(r[i]) - borrow - (i < b.size() ? b[i] : 0);
+			borrow = d < 0;
+			r[i] = uint32_t(borrow ? d + BASE : d);
+		}
+		return r;
+	}
+
+	static vector<uint32_t> mulSmall(const vector<uint32_t>& a, uint32_t m) {
+		vector<uint32_t> r;
+		uint64_t carry = 0;
+		for (size_t i = 0; i < a.size() || carry; i++) {
+			uint64_t d = carry + (i < a.size() ? uint64_t(a[i]) * m : 0);
+			r.push_back(uint32_t(d % BASE));
+			carry = d / BASE;
+		}
+		return r;
+	}
+
+public:
+	BigInt() :
+			neg(false) {
+	}
+	BigInt(long long v) :
+			neg(v < 0) {
+		// negate as unsigned so that LLONG_MIN is representable
+		unsigned long long m = neg ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+		while (m) {
+			mag.push_back(uint32_t(m % BASE));
+			m /= BASE;
+		}
+	}
+
+	// s is a string of decimal digits with an optional leading -
+	static BigInt fromString(const string& s) {
+		BigInt r;
+		size_t first = (!s.empty() && s[0] == '-') ? 1 : 0;
+		for (size_t end = s.size(); end > first;) {
+			size_t start = end >= first + 9 ? end - 9 : first;
+			r.mag.push_back(uint32_t(stoul(s.substr(start, end - start))));
+			end = start;
+		}
+		r.neg = first == 1;
+		r.trim();
+		return r;
+	}
+
+	// the bytes held for the digits
+	size_t heapBytes() const {
+		return mag.capacity() * sizeof(uint32_t);
+	}
+
+	bool fitsInt64() const {
+		// two limbs are below 10^18, four are at least 10^27
+		if (mag.size() != 3) {
+			return mag.size() < 3;
+		}
+		return compareMag(mag, neg ? BigInt(LLONG_MIN).mag : BigInt(LLONG_MAX).mag) <= 0;
+	}
+
+	long long toInt64() const {
+		unsigned long long m = 0;
+		for (size_t i = mag.size(); i-- > 0;) {
+			m = m * BASE + mag[i];
+		}
+		return neg ? (long long) (0ULL - m) : (long long) m;
+	}
+
+	bool isZero() const {
+		return mag.empty();
+	}
+
+	bool isNegative() const {
+		return neg;
+	}
+
+	int compare(const BigInt& b) const {
+		if (neg != b.neg) {
+			return neg ? -1 : 1;
+		}
+		int c = compareMag(mag, b.mag);
+		return neg ? -c : c;
+	}
+
+	BigInt operator-() const {
+		BigInt r(*this);
+		r.neg = !neg;
+		r.trim();
+		return r;
+	}
+
+	BigInt operator+(const BigInt& b) const {
+		BigInt r;
+		if (neg == b.neg) {
+			r.mag = addMag(mag, b.mag);
+			r.neg = neg;
+		}
+		else if (compareMag(mag, b.mag) >= 0) {
+			r.mag = subMag(mag, b.mag);
+			r.neg = neg;
+		}
+		else {
+			r.mag = subMag(b.mag, mag);
+			r.neg = b.neg;
+		}
+		r.trim();
+		return r;
+	}
+
+	BigInt operator-(const BigInt& b) const {
+		return *this + -b;
+	}
+
+	BigInt operator*(const BigInt& b) const {
+		BigInt r;
+		vector<uint64_t> acc(mag.size() + b.mag.size() + 1, 0);
+		for (size_t i = 0; i < mag.size(); i++) {
+			uint64_t carry = 0;
+			for (size_t j = 0; j < b.mag.size() || carry; j++) {
+				uint64_t d = acc[i + j] + carry + (j < b.mag.size() ? uint64_t(mag[i]) * b.mag[j] : 0);
+				acc[i + j] = d % BASE;
+				carry = d / BASE;
+			}
+		}
+		r.mag.assign(acc.begin(), acc.end());
+		r.neg = neg != b.neg;
+		r.trim();
+		return r;
+	}
+
+	// truncating division like the built in integer /; b must not be zero
+	BigInt operator/(const BigInt& b) const {
+		BigInt q, rem;
+		q.mag.assign(mag.size(), 0);
+		for (size_t i = mag.size(); i-- > 0;) {
+			// rem = rem * BASE + mag[i], then find the largest digit d with b * d <= rem
+			rem.mag.insert(rem.mag.begin(), mag[i]);
+			rem.trim();
+			uint32_t lo = 0, hi = BASE - 1;
+			while (lo < hi) {
+				uint32_t mid = lo + (hi - lo + 1) / 2;
+				if (compareMag(mulSmall(b.mag, mid), rem.mag) <= 0) {
+					lo = mid;
+				}
+				else {
+					hi = mid - 1;
+				}
+			}
+			q.mag[i] = lo;
+			if (lo) {
+				vector<uint32_t> sub = mulSmall(b.mag, lo);
+				while (!sub.empty() && sub.back() == 0) {
+					sub.pop_back();
+				}
+				rem.mag = subMag(rem.mag, sub);
+				rem.trim();
+			}
+		}
+		q.neg = neg != b.neg;
+		q.trim();
+		return q;
+	}
+
+	string toString() const {
+		if (mag.empty()) {
+			return "0";
+		}
+		string s = neg ? "-" : "";
+		s += to_string(mag.back());
+		for (size_t i = mag.size() - 1; i-- > 0;) {
+			string digits = to_string(mag[i]);
+			s += string(9 - digits.size(), '0') + digits;
+		}
+		return s;
+	}
+};
+
+#endif /* BIGINT_H_ */
@@ -0,0 +1,106 @@
+/*
+ * budget.h
+ */
+
+#ifndef BUDGET_H_
+#define BUDGET_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "rtError.h"
+using namespace std;
+
+// limits on one execution, so that a single script cannot hold a thread for
+// long: the parse tree nodes of the statements run, the wall time, and the
+// length of the strings made. Statements are charged as they start, with
+// the clock read only every CLOCK_EVERY nodes; strings are charged before
+// they are built, so a huge repetition fails before anything is allocated.
+// Exceeding a limit raises a runtime error that no enclosing node rewords
+class ExecBudget {
+public:
+	// zero means no limit
+	struct Limits {
+		size_t nodes;
+		long long millis;
+		size_t stringBytes;
+
+		Limits() :
+				nodes(0), millis(0), stringBytes(0) {
+		}
+
+		bool any() const {
+			return nodes || millis || stringBytes;
+		}
+	};
+
+private:
+	static const size_t CLOCK_EVERY = 256;
+
+	Limits limits;
+	size_t nodes;
+	size_t stringBytes;
+	size_t sinceClock;
+	chrono::steady_clock::time_point deadline;
+
+public:
+	// the clock starts now
+	ExecBudget(const Limits& limits) :
+			limits(limits), nodes(0), stringBytes(0), sinceClock(0), deadline(
+					chrono::steady_clock::now() + chrono::milliseconds(limits.millis)) {
+	}
+
+	// charges a statement of n nodes about to run at line
+	void chargeNodes(size_t n, int line) {
+		nodes += n;
+		if (limits.nodes && nodes > limits.nodes) {
+			exceeded(line, "Node budget exceeded");
+		}
+		sinceClock += n;
+		if (limits.millis && sinceClock >= CLOCK_EVERY) {
+			sinceClock = 0;
+			if (chrono::steady_clock::now() > deadline) {
+				exceeded(line, "Time budget exceeded");
+			}
+		}
+	}
+
+	// charges a string of count copies of length bytes, before it is made
+	void chargeString(size_t length, size_t count = 1) {
+		size_t bytes;
+		if (__builtin_mul_overflow(length, count, &bytes) || __builtin_add_overflow(stringBytes, bytes, &stringBytes)) {
+			stringBytes = SIZE_MAX;
+		}
+		if (limits.stringBytes && stringBytes > limits.stringBytes) {
+			exceeded(RuntimeError::NO_LINE, "String budget exceeded");
+		}
+	}
+
+	// the budget the executions on this thread are charged to, if any
+	static ExecBudget *&active() {
+		static thread_local ExecBudget *budget = nullptr;
+		return budget;
+	}
+
+	class Scope {
+		ExecBudget *previous;
+
+	public:
+		Scope(ExecBudget *budget) :
+				previous(active()) {
+			active() = budget;
+		}
+		~Scope() {
+			active() = previous;
+		}
+	};
+
+private:
+	[[noreturn]] __attribute__((noinline, cold)) static void exceeded(int line, const char *msg) {
+		RuntimeError e(msg, line);
+		e.budget = true;
+		throw e;
+	}
+};
+
+#endif /* BUDGET_H_ */
@@ -0,0 +1,405 @@
+/*
+ * column.h
+ */
+
+#ifndef COLUMN_H_
+#define COLUMN_H_
+
+#include <vector>
+#include <map>
+#include <string>
+#include <climits>
+#include "value.h"
+#include "strkernels.h"
+using namespace std;
+
+// kernels over columns of 64-bit integers. Addition, subtraction and the
+// comparisons use AVX2 when the cpu has it, SSE2 or plain loops otherwise.
+// Arithmetic reports whether any lane overflowed instead of promoting, so the
+// caller can redo the column one row at a time
+namespace ColumnKernels {
+
+enum Compare {
+	LT, LE, GT, GE, EQ, NE
+};
+
+inline bool addScalar(const long long *a, const long long *b, long long *r, size_t n) {
+	bool overflow = false;
+	for (size_t i = 0; i < n; i++) {
+		overflow |= __builtin_add_overflow(a[i], b[i], &r[i]);
+	}
+	return overflow;
+}
+
+inline bool subScalar(const long long *a, const long long *b, long long *r, size_t n) {
+	bool overflow = false;
+	for (size_t i = 0; i < n; i++) {
+		overflow |= __builtin_sub_overflow(a[i], b[i], &r[i]);
+	}
+	return overflow;
+}
+
+inline void compareScalar(Compare op, const long long *a, const long long *b, long long *r, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		switch (op) {
+		case LT:
+			r[i] = a[i] < b[i];
+			break;
+		case LE:
+			r[i] = a[i] <= b[i];
+			break;
+		case GT:
+			r[i] = a[i] > b[i];
+			break;
+		case GE:
+			r[i] = a[i] >= b[i];
+			break;
+		case EQ:
+			r[i] = a[i] == b[i];
+			break;
+		default:
+			r[i] = a[i] != b[i];
+			break;
+		}
+	}
+}
+
+#ifdef STRKERNELS_X86
+// the sign of (a ^ r) & (b ^ r) is set in a lane whose sum overflowed, and
+// that of (a ^ b) & (a ^ r) in a lane whose difference did
+__attribute__((target("avx2"))) inline bool addAVX2(const long long *a, const long long *b, long long *r, size_t n) {
+	__m256i overflow = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		__m256i s = _mm256_add_epi64(x, y);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i), s);
+		overflow = _mm256_or_si256(overflow,
+				_mm256_and_si256(_mm256_xor_si256(x, s), _mm256_xor_si256(y, s)));
+	}
+	return _mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0 || addScalar(a + i, b + i, r + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline bool subAVX2(const long long *a, const long long *b, long long *r, size_t n) {
+	__m256i overflow = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		__m256i d = _mm256_sub_epi64(x, y);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i), d);
+		overflow = _mm256_or_si256(overflow,
+				_mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, d)));
+	}
+	return _mm256_movemask_pd(_mm256_castsi256_pd(overflow)) != 0 || subScalar(a + i, b + i, r + i, n - i);
+}
+
+// every comparison is a greater-than or an equality, possibly with the
+// operands swapped and the result inverted
+__attribute__((target("avx2"))) inline void compareAVX2(Compare op, const long long *a, const long long *b,
+		long long *r, size_t n) {
+	bool swap = op == LT || op == GE;
+	bool invert = op == LE || op == GE || op == NE;
+	bool equality = op == EQ || op == NE;
+	const long long *x = swap ? b : a;
+	const long long *y = swap ? a : b;
+	__m256i one = _mm256_set1_epi64x(1);
+	__m256i flip = invert ? one : _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x + i));
+		__m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(y + i));
+		__m256i m = equality ? _mm256_cmpeq_epi64(p, q) : _mm256_cmpgt_epi64(p, q);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i), _mm256_xor_si256(_mm256_and_si256(m, one), flip));
+	}
+	compareScalar(op, a + i, b + i, r + i, n - i);
+}
+#endif
+
+// r[i] = a[i] + b[i]; true if any lane overflowed
+inline bool add(const long long *a, const long long *b, long long *r, size_t n) {
+#ifdef STRKERNELS_X86
+	if (StrKernels::hasAVX2()) {
+		return addAVX2(a, b, r, n);
+	}
+#endif
+	return addScalar(a, b, r, n);
+}
+
+inline bool sub(const long long *a, const long long *b, long long *r, size_t n) {
+#ifdef STRKERNELS_X86
+	if (StrKernels::hasAVX2()) {
+		return subAVX2(a, b, r, n);
+	}
+#endif
+	return subScalar(a, b, r, n);
+}
+
+// there is no 64-bit vector multiply below AVX-512, so this stays scalar
+inline bool mul(const long long *a, const long long *b, long long *r, size_t n) {
+	bool overflow = false;
+	for (size_t i = 0; i < n; i++) {
+		overflow |= __builtin_mul_overflow(a[i], b[i], &r[i]);
+	}
+	return overflow;
+}
+
+// r[i] is 1 where a[i] op b[i] holds and 0 elsewhere
+inline void compare(Compare op, const long long *a, const long long *b, long long *r, size_t n) {
+#ifdef STRKERNELS_X86
+	if (StrKernels::hasAVX2()) {
+		compareAVX2(op, a, b, r, n);
+		return;
+	}
+#endif
+	compareScalar(op, a, b, r, n);
+}
+
+// dst[i] = src[i] where mask[i] is set
+inline void select(const char *mask, const long long *src, long long *dst, size_t n) {
+	for (size_t i = 0; i < n; i++) {
+		long long keep = -(long long) (mask[i] == 0);
+		dst[i] = (dst[i] & keep) | (src[i] & ~keep);
+	}
+}
+
+}
+
+// one value per row of a RowBatch. Integer and boolean columns keep raw
+// 64-bit lanes, booleans as 0 or 1, and have a value in every row; any other
+// column keeps Values, where an empty Value is a name the row never assigned
+class Column {
+public:
+	enum Kind {
+		INTS, BOOLS, VALUES
+	};
+
+	Kind kind;
+	vector<long long> lanes;
+	vector<Value> values;
+
+	Column() :
+			kind(VALUES) {
+	}
+
+	void fill(const Value& v, size_t rows) {
+		lanes.clear();
+		values.clear();
+		if (v.isBoolType()) {
+			kind = BOOLS;
+			lanes.assign(rows, v.isTrue());
+		}
+		else if (v.isSmallInt()) {
+			kind = INTS;
+			lanes.assign(rows, v.getInteger());
+		}
+		else {
+			kind = VALUES;
+			values.assign(rows, v);
+		}
+	}
+
+	Value at(size_t i) const {
+		if (kind == INTS) {
+			return Value(lanes[i]);
+		}
+		if (kind == BOOLS) {
+			return Value(lanes[i] != 0);
+		}
+		return values[i];
+	}
+
+	void toValues() {
+		if (kind != VALUES) {
+			values.resize(lanes.size());
+			for (size_t i = 0; i < lanes.size(); i++) {
+				values[i] = at(i);
+			}
+			lanes.clear();
+			kind = VALUES;
+		}
+	}
+};
+
+// the state of a block of rows run through the program together. Rows drop
+// out of active inside an if whose condition is false for them, and for good
+// once they fail. A failed row's output and variables are left incomplete;
+// the caller runs it again on its own to find out what the error was
+class RowBatch {
+public:
+	size_t rows;
+	vector<char> active;
+	vector<char> failed;
+	map<const string *, Column> variables;
+	vector<string> output;
+
+	explicit RowBatch(size_t rows) :
+			rows(rows), active(rows, 1), failed(rows, 0), output(rows) {
+	}
+
+	void fail(size_t i) {
+		failed[i] = 1;
+		active[i] = 0;
+	}
+
+	void failActive() {
+		for (size_t i = 0; i < rows; i++) {
+			if (active[i]) {
+				fail(i);
+			}
+		}
+	}
+
+	bool anyActive() const {
+		for (size_t i = 0; i < rows; i++) {
+			if (active[i]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// every row that has not failed takes part
+	bool allLive() const {
+		for (size_t i = 0; i < rows; i++) {
+			if (!active[i] && !failed[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// result = l op r over two integer columns; false, with nothing failed,
+	// when the columns are not both integers or an active row overflowed
+	bool arith(char op, const Column& l, const Column& r, Column& result) const {
+		if (l.kind != Column::INTS || r.kind != Column::INTS) {
+			return false;
+		}
+		result.kind = Column::INTS;
+		result.values.clear();
+		result.lanes.resize(rows);
+		const long long *a = l.lanes.data(), *b = r.lanes.data();
+		long long *out = result.lanes.data();
+		bool overflow;
+		switch (op) {
+		case '+':
+			overflow = ColumnKernels::add(a, b, out, rows);
+			break;
+		case '-':
+			overflow = ColumnKernels::sub(a, b, out, rows);
+			break;
+		case '*':
+			overflow = ColumnKernels::mul(a, b, out, rows);
+			break;
+		default:
+			for (size_t i = 0; i < rows; i++) {
+				if (active[i] && (b[i] == 0 || (a[i] == LLONG_MIN && b[i] == -1))) {
+					return false;
+				}
+			}
+			for (size_t i = 0; i < rows; i++) {
+				out[i] = active[i] ? a[i] / b[i] : 0;
+			}
+			return true;
+		}
+		// lanes of inactive rows may hold anything, so only an overflow in
+		// an active row counts
+		if (overflow) {
+			long long checked;
+			for (size_t i = 0; i < rows; i++) {
+				if (active[i] && arithOverflows(op, a[i], b[i], checked)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// result = l op r over two integer columns, or equality of two boolean ones
+	bool compare(ColumnKernels::Compare op, const Column& l, const Column& r, Column& result) const {
+		bool equality = op == ColumnKernels::EQ || op == ColumnKernels::NE;
+		if (l.kind == Column::VALUES || l.kind != r.kind || (l.kind == Column::BOOLS && !equality)) {
+			return false;
+		}
+		result.kind = Column::BOOLS;
+		result.values.clear();
+		result.lanes.resize(rows);
+		ColumnKernels::compare(op, l.lanes.data(), r.lanes.data(), result.lanes.data(), rows);
+		return true;
+	}
+
+	// && and || of two boolean columns
+	bool logic(char op, const Column& l, const Column& r, Column& result) const {
+		if (l.kind != Column::BOOLS || r.kind != Column::BOOLS) {
+			return false;
+		}
+		result.kind = Column::BOOLS;
+		result.values.clear();
+		result.lanes.resize(rows);
+		for (size_t i = 0; i < rows; i++) {
+			result.lanes[i] = op == '&' ? l.lanes[i] & r.lanes[i] : l.lanes[i] | r.lanes[i];
+		}
+		return true;
+	}
+
+	// result = op(l, r) one active row at a time, through the same Value
+	// operators a sequential run uses; a row whose operator raises fails
+	template<class Op>
+	void combine(const Column& l, const Column& r, Column& result, Op op) {
+		result.kind = Column::VALUES;
+		result.lanes.clear();
+		result.values.assign(rows, Value());
+		for (size_t i = 0; i < rows; i++) {
+			if (active[i]) {
+				try {
+					Value a = l.at(i);
+					result.values[i] = op(a, r.at(i));
+				}
+				catch (RuntimeError&) {
+					fail(i);
+				}
+			}
+		}
+	}
+
+	// stores value into name for the active rows only. value is copied, not
+	// moved: it is also the result of the assignment, which a chained or
+	// nested assignment goes on to use
+	void assign(const string *name, const Column& value) {
+		if (allLive()) {
+			variables[name] = value;
+			return;
+		}
+		map<const string *, Column>::iterator it = variables.find(name);
+		if (it == variables.end()) {
+			it = variables.emplace(name, Column()).first;
+			it->second.values.assign(rows, Value());
+		}
+		Column& dst = it->second;
+		if (dst.kind != Column::VALUES && dst.kind == value.kind) {
+			ColumnKernels::select(active.data(), value.lanes.data(), dst.lanes.data(), rows);
+			return;
+		}
+		dst.toValues();
+		for (size_t i = 0; i < rows; i++) {
+			if (active[i]) {
+				dst.values[i] = value.at(i);
+			}
+		}
+	}
+
+private:
+	static bool arithOverflows(char op, long long a, long long b, long long& r) {
+		switch (op) {
+		case '+':
+			return __builtin_add_overflow(a, b, &r);
+		case '-':
+			return __builtin_sub_overflow(a, b, &r);
+		default:
+			return __builtin_mul_overflow(a, b, &r);
+		}
+	}
+};
+
+#endif /* COLUMN_H_ */
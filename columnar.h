@@ -0,0 +1,307 @@
+/*
+ * columnar.h
+ */
+
+#ifndef COLUMNAR_H_
+#define COLUMNAR_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <charconv>
+#include <istream>
+#include "parse.h"
+using namespace std;
+
+// runs one program over every record of a CSV file. The header names the
+// variables a record binds, and each cell becomes an integer, True or False
+// when it reads as one, an unset variable when it is empty, and a string
+// otherwise, or always when quoted.
+//
+// Records are run in blocks through EvalRows, so integer arithmetic and
+// comparisons go over whole columns at once. A record that fails is run
+// again on its own to get the same output and error a sequential run gives,
+// and the rest of the block carries on. The result is CSV again: the record
+// number, the printed output, the final value of every variable, and the
+// runtime error if there was one
+class ColumnarRunner {
+	static const size_t BLOCK = 1024;
+
+	struct Cell {
+		string text;
+		bool quoted;
+	};
+
+	ParseTree *prog;
+	vector<const string *> inputs;
+	// every input and every name the program assigns, in name order
+	vector<const string *> outputs;
+
+public:
+	ColumnarRunner(ParseTree *prog) :
+			prog(prog) {
+	}
+
+	// returns the number of records that failed
+	size_t run(istream& in) {
+		OutputSink& out = OutputSink::standardOutput();
+		OutputSink& err = OutputSink::standardError();
+		vector<Cell> header;
+		if (!readRecord(in, header)) {
+			err << "MISSING CSV HEADER\n";
+			err.flush();
+			return 0;
+		}
+		set<const string *> names, writes;
+		for (Cell& c : header) {
+			inputs.push_back(&InternTable::instance().name(c.text));
+			names.insert(inputs.back());
+		}
+		prog->Access(names, writes);
+		names.insert(writes.begin(), writes.end());
+		outputs.assign(names.begin(), names.end());
+		sort(outputs.begin(), outputs.end(), [](const string *a, const string *b) {
+			return *a < *b;
+		});
+
+		out << "row,output";
+		for (const string *name : outputs) {
+			out << ',';
+			writeField(out, *name, false);
+		}
+		out << ",error\n";
+
+		size_t row = 0, failed = 0;
+		vector<vector<Cell>> block;
+		while (true) {
+			block.clear();
+			vector<Cell> record;
+			while (block.size() < BLOCK && readRecord(in, record)) {
+				record.resize(inputs.size());
+				block.push_back(std::move(record));
+			}
+			if (block.empty()) {
+				break;
+			}
+			failed += runBlock(block, row, out);
+			row += block.size();
+		}
+		out.flush();
+		err << "ROWS SUMMARY: " << (long long) row << " rows, " << (long long) failed << " failed\n";
+		err.flush();
+		return failed;
+	}
+
+private:
+	size_t runBlock(const vector<vector<Cell>>& block, size_t first, OutputSink& out) {
+		RowBatch batch(block.size());
+		for (size_t j = 0; j < inputs.size(); j++) {
+			bind(batch, block, j);
+		}
+		Column scratch;
+		prog->EvalRows(batch, scratch);
+
+		size_t failed = 0;
+		for (size_t i = 0; i < block.size(); i++) {
+			out << (long long) (first + i) << ',';
+			if (!batch.failed[i]) {
+				writeField(out, batch.output[i], false);
+				for (const string *name : outputs) {
+					out << ',';
+					map<const string *, Column>::const_iterator it = batch.variables.find(name);
+					if (it != batch.variables.end()) {
+						writeValue(out, it->second, i);
+					}
+				}
+				out << ",\n";
+			}
+			else {
+				failed++;
+				rerun(block[i], out);
+			}
+		}
+		return failed;
+	}
+
+	// the column for input j, with raw lanes if every cell is an integer or
+	// every cell a boolean
+	void bind(RowBatch& batch, const vector<vector<Cell>>& block, size_t j) {
+		Column column;
+		column.kind = Column::INTS;
+		column.lanes.resize(block.size());
+		for (size_t i = 0; i < block.size() && column.kind == Column::INTS; i++) {
+			if (!parseInt(block[i][j], column.lanes[i])) {
+				column.kind = Column::VALUES;
+			}
+		}
+		if (column.kind == Column::VALUES) {
+			column.lanes.clear();
+			column.values.resize(block.size());
+			bool bools = true;
+			for (size_t i = 0; i < block.size(); i++) {
+				column.values[i] = parseCell(block[i][j]);
+				bools = bools && column.values[i].isBoolType();
+			}
+			if (bools) {
+				column.kind = Column::BOOLS;
+				for (size_t i = 0; i < block.size(); i++) {
+					column.lanes.push_back(column.values[i].isTrue());
+				}
+				column.values.clear();
+			}
+		}
+		batch.variables[inputs[j]] = std::move(column);
+	}
+
+	// runs one record the ordinary way, for its exact output and error
+	void rerun(const vector<Cell>& record, OutputSink& out) {
+		SymbolTable symbols;
+		for (size_t j = 0; j < inputs.size(); j++) {
+			Value v = parseCell(record[j]);
+			if (v.hasValue()) {
+				symbols[*inputs[j]] = v;
+			}
+		}
+		OutputSink printed, error;
+		OutputSink *previousOut = OutputSink::active();
+		OutputSink *previousErr = OutputSink::activeError();
+		OutputSink::active() = &printed;
+		OutputSink::activeError() = &error;
+		prog->Run(&symbols);
+		OutputSink::active() = previousOut;
+		OutputSink::activeError() = previousErr;
+
+		writeField(out, printed.take(), false);
+		for (const string *name : outputs) {
+			out << ',';
+			SymbolTable::const_iterator it = symbols.find(*name);
+			writeValue(out, it == symbols.end() ? Value() : it->second);
+		}
+		string message = error.take();
+		if (!message.empty() && message.back() == '\n') {
+			message.pop_back();
+		}
+		out << ',';
+		writeField(out, message, false);
+		out << '\n';
+	}
+
+	static Value parseCell(const Cell& c) {
+		const string& s = c.text;
+		if (c.quoted) {
+			return Value(s);
+		}
+		if (s.empty()) {
+			return Value();
+		}
+		if (s == "True" || s == "true") {
+			return Value(true);
+		}
+		if (s == "False" || s == "false") {
+			return Value(false);
+		}
+		long long n;
+		if (parseInt(c, n)) {
+			return Value(n);
+		}
+		size_t digits = s[0] == '-' ? 1 : 0;
+		if (s.size() > digits && s.find_first_not_of("0123456789", digits) == string::npos) {
+			return Value(BigInt::fromString(s));
+		}
+		return Value(s);
+	}
+
+	// an unquoted cell holding a 64-bit integer
+	static bool parseInt(const Cell& c, long long& n) {
+		const string& s = c.text;
+		if (c.quoted || s.empty() || s[0] == '+') {
+			return false;
+		}
+		from_chars_result r = from_chars(s.data(), s.data() + s.size(), n);
+		return r.ec == errc() && r.ptr == s.data() + s.size();
+	}
+
+	// one record; quoted cells may hold commas, doubled quotes and line breaks
+	static bool readRecord(istream& in, vector<Cell>& cells) {
+		cells.clear();
+		string line;
+		if (!getline(in, line)) {
+			return false;
+		}
+		cells.push_back(Cell { string(), false });
+		bool quoting = false;
+		while (true) {
+			for (size_t i = 0; i < line.size(); i++) {
+				char c = line[i];
+				Cell& cell = cells.back();
+				if (quoting) {
+					if (c != '"') {
+						cell.text += c;
+					}
+					else if (i + 1 < line.size() && line[i + 1] == '"') {
+						cell.text += c;
+						i++;
+					}
+					else {
+						quoting = false;
+					}
+				}
+				else if (c == '"') {
+					quoting = cell.quoted = true;
+				}
+				else if (c == ',') {
+					cells.push_back(Cell { string(), false });
+				}
+				else if (c != '\r') {
+					cell.text += c;
+				}
+			}
+			// a line break inside quotes belongs to the cell
+			if (!quoting || !getline(in, line)) {
+				break;
+			}
+			cells.back().text += '\n';
+		}
+		return true;
+	}
+
+	// strings are always quoted, so that they read back as strings
+	static void writeValue(OutputSink& out, const Value& v) {
+		if (v.isStringType()) {
+			writeField(out, v.getString(), true);
+		}
+		else if (v.hasValue()) {
+			out << v;
+		}
+	}
+
+	static void writeValue(OutputSink& out, const Column& column, size_t i) {
+		if (column.kind == Column::INTS) {
+			out << column.lanes[i];
+		}
+		else if (column.kind == Column::BOOLS) {
+			out << (column.lanes[i] ? "True" : "False");
+		}
+		else {
+			writeValue(out, column.values[i]);
+		}
+	}
+
+	static void writeField(OutputSink& out, string_view s, bool quote) {
+		if (!quote && s.find_first_of(",\"\r\n") == string_view::npos) {
+			out << s;
+			return;
+		}
+		out << '"';
+		size_t start = 0;
+		for (size_t q = s.find('"'); q != string_view::npos; q = s.find('"', start)) {
+			out << s.substr(start, q + 1 - start) << '"';
+			start = q + 1;
+		}
+		out << s.substr(start) << '"';
+	}
+};
+
+#endif /* COLUMNAR_H_ */
@@ -0,0 +1,163 @@
+/*
+ * coop.h
+ */
+
+#ifndef COOP_H_
+#define COOP_H_
+
+#include <coroutine>
+#include <deque>
+#include <vector>
+#include <map>
+#include <string>
+#include <exception>
+#include "parsetree.h"
+using namespace std;
+
+// a coroutine that runs until it suspends or returns. It starts suspended, so
+// nothing happens until the first resume()
+class CoTask {
+public:
+	struct promise_type {
+		CoTask get_return_object() {
+			return CoTask(coroutine_handle<promise_type>::from_promise(*this));
+		}
+		suspend_always initial_suspend() noexcept {
+			return suspend_always();
+		}
+		suspend_always final_suspend() noexcept {
+			return suspend_always();
+		}
+		void return_void() {
+		}
+		void unhandled_exception() {
+			terminate();
+		}
+	};
+
+	CoTask() :
+			handle(nullptr) {
+	}
+	CoTask(CoTask&& t) noexcept :
+			handle(t.handle) {
+		t.handle = nullptr;
+	}
+	CoTask& operator=(CoTask&& t) noexcept {
+		if (this != &t) {
+			if (handle) {
+				handle.destroy();
+			}
+			handle = t.handle;
+			t.handle = nullptr;
+		}
+		return *this;
+	}
+	CoTask(const CoTask&) = delete;
+	CoTask& operator=(const CoTask&) = delete;
+
+	~CoTask() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	// runs to the next suspension; false once the coroutine has returned
+	bool resume() {
+		if (!handle.done()) {
+			handle.resume();
+		}
+		return !handle.done();
+	}
+
+private:
+	explicit CoTask(coroutine_handle<promise_type> h) :
+			handle(h) {
+	}
+
+	coroutine_handle<promise_type> handle;
+};
+
+// round robin over the coroutines of one thread: each runs until it
+// suspends, then goes to the back of the queue
+class CoScheduler {
+	deque<CoTask> ready;
+	size_t switches;
+
+public:
+	CoScheduler() :
+			switches(0) {
+	}
+
+	void spawn(CoTask task) {
+		ready.push_back(std::move(task));
+	}
+
+	// returns once every coroutine has finished
+	void run() {
+		while (!ready.empty()) {
+			CoTask task = std::move(ready.front());
+			ready.pop_front();
+			switches++;
+			if (task.resume()) {
+				ready.push_back(std::move(task));
+			}
+		}
+	}
+
+	// number of times a coroutine was resumed
+	size_t getSwitches() const {
+		return switches;
+	}
+};
+
+// runs the statements of prog against symbolTable, suspending between two
+// top level statements once the statements run since the last suspension
+// hold quantum nodes or more; a quantum of 1 suspends after every statement.
+// A statement always runs to its end. Output and errors go to out and err,
+// which are the thread's sinks only while the coroutine runs, as budget, when
+// given, is the thread's budget; a runtime error ends the coroutine with its
+// line and message in *failure
+inline CoTask runCooperative(const ParseTree *prog, SymbolTable *symbolTable, OutputSink *out,
+		OutputSink *err, size_t quantum, string *failure, ExecBudget *budget = 0) {
+	OutputSink *previousOut = OutputSink::active();
+	OutputSink *previousErr = OutputSink::activeError();
+	ExecBudget *previousBudget = ExecBudget::active();
+	OutputSink::active() = out;
+	OutputSink::activeError() = err;
+	ExecBudget::active() = budget;
+	size_t spent = 0;
+	for (const ParseTree *l = prog; l != 0; l = l->right) {
+		if (spent >= quantum) {
+			spent = 0;
+			OutputSink::active() = previousOut;
+			OutputSink::activeError() = previousErr;
+			ExecBudget::active() = previousBudget;
+			co_await suspend_always();
+			// the coroutine may have moved to another thread's sinks
+			previousOut = OutputSink::active();
+			previousErr = OutputSink::activeError();
+			previousBudget = ExecBudget::active();
+			OutputSink::active() = out;
+			OutputSink::activeError() = err;
+			ExecBudget::active() = budget;
+		}
+		ErrorState& state = ErrorState::current();
+		state.clear();
+		try {
+			static_cast<const StmtList *>(l)->EvalHead(symbolTable);
+		}
+		catch (RuntimeError& e) {
+			state.record(e);
+		}
+		if (state.hasFailed()) {
+			*failure = "runtime error at line " + to_string(state.getLine()) + ": " + state.getMessage();
+			break;
+		}
+		spent += static_cast<const StmtList *>(l)->HeadNodes();
+	}
+	OutputSink::active() = previousOut;
+	OutputSink::activeError() = previousErr;
+	ExecBudget::active() = previousBudget;
+}
+
+#endif /* COOP_H_ */
@@ -0,0 +1,117 @@
+/*
+ * forkserver.h
+ */
+
+#ifndef FORKSERVER_H_
+#define FORKSERVER_H_
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "server.h"
+using namespace std;
+
+// daemon for scripts that share a large prelude. The prelude is parsed and
+// run once, up front; then every connection is handed to a forked child,
+// which starts with the prelude's symbol table already filled in, shared
+// copy-on-write with the daemon, runs the script against it and exits.
+// Nothing a script does reaches the daemon or the next script.
+//
+// Requests and replies are the ones --serve uses, except that there are no
+// named tables: the first line of a request must be empty
+class ForkServer {
+	string path;
+	ExecBudget::Limits limits;
+	int listener;
+	ParseTree *prelude;
+	SymbolTable symbols;
+
+public:
+	ForkServer(const string& path, const ExecBudget::Limits& limits = ExecBudget::Limits()) :
+			path(path), limits(limits), listener(-1), prelude(0) {
+	}
+
+	~ForkServer() {
+		delete prelude;
+	}
+
+	// runs the prelude, whose output goes to stdout, and listens on the
+	// socket; returns false after reporting on stderr if either fails
+	bool start(istream *in) {
+		int line = 0;
+		prelude = Prog(in, &line);
+		if (prelude == 0) {
+			return false;
+		}
+		prelude->Run(&symbols);
+		OutputSink::standardOutput().flush();
+		if (ErrorState::current().hasFailed()) {
+			cerr << "PRELUDE FAILED" << endl;
+			return false;
+		}
+		listener = Server::listenOn(path);
+		return listener >= 0;
+	}
+
+	// accepts connections until the process is killed
+	void run() {
+		// children are reaped as they exit
+		signal(SIGCHLD, SIG_IGN);
+		while (true) {
+			int fd = accept(listener, 0, 0);
+			if (fd < 0) {
+				continue;
+			}
+			pid_t child = fork();
+			if (child == 0) {
+				close(listener);
+				handle(fd);
+				_exit(0);
+			}
+			if (child < 0) {
+				cerr << "COULD NOT FORK: " << strerror(errno) << endl;
+			}
+			close(fd);
+		}
+	}
+
+private:
+	// runs in the child, against its own copy of the symbol table
+	void handle(int fd) {
+		string request;
+		if (!Server::readRequest(fd, request)) {
+			return;
+		}
+		size_t eol = request.find('\n');
+		istringstream in(eol == string::npos ? string() : request.substr(eol + 1));
+
+		OutputSink out(fd, OutputSink::BYTES), err(fd, OutputSink::BYTES);
+		out.setFrameTag('o');
+		err.setFrameTag('e');
+		OutputSink::active() = &out;
+		OutputSink::activeError() = &err;
+
+		if (eol != 0) {
+			err << "NAMED TABLES NEED --serve\n";
+		}
+		else {
+			int line = 0;
+			ParseTree *prog = Prog(&in, &line);
+			if (prog != 0) {
+				ExecBudget budget(limits);
+				ExecBudget::Scope scope(limits.any() ? &budget : 0);
+				ExecArena arena;
+				prog->Run(&symbols, &arena);
+			}
+		}
+
+		out.flush();
+		err.flush();
+		send(fd, "x 0\n", 4, MSG_NOSIGNAL);
+	}
+};
+
+#endif /* FORKSERVER_H_ */
@@ -0,0 +1,82 @@
+/*
+ * intern.h
+ */
+
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include "rope.h"
+using namespace std;
+
+// keeps one canonical rope leaf per distinct string constant and identifier
+// name, so those are stored once and compare equal by pointer. The table is
+// shared by every thread that parses a program; strings built at runtime
+// never go through it, so running takes no lock here
+class InternTable {
+	unordered_map<string, Rope> strings;
+	mutable mutex lock;
+
+public:
+	static InternTable& instance() {
+		static InternTable table;
+		return table;
+	}
+
+	const Rope& intern(const string& s) {
+		return entry(s).second;
+	}
+
+	// a string constant being parsed: the canonical copy, or a leaf of its
+	// own while this thread parses transient statements
+	Rope constant(const string& s) {
+		return transient() ? Rope::heapLeaf(s) : intern(s);
+	}
+
+	// true while this thread parses statements that are freed once they
+	// have run. Their constants stay out of the table, which is never
+	// pruned and would otherwise grow with every distinct literal
+	static bool& transient() {
+		static thread_local bool parsing = false;
+		return parsing;
+	}
+
+	class Transient {
+		bool previous;
+
+	public:
+		Transient() :
+				previous(transient()) {
+			transient() = true;
+		}
+		~Transient() {
+			transient() = previous;
+		}
+	};
+
+	// the canonical copy of an identifier name
+	const string& name(const string& s) {
+		return entry(s).first;
+	}
+
+	size_t size() const {
+		lock_guard<mutex> guard(lock);
+		return strings.size();
+	}
+
+private:
+	// entries are never removed and unordered_map nodes do not move, so the
+	// reference stays valid after the lock is released
+	const pair<const string, Rope>& entry(const string& s) {
+		lock_guard<mutex> guard(lock);
+		unordered_map<string, Rope>::iterator it = strings.find(s);
+		if (it == strings.end()) {
+			it = strings.emplace(s, Rope::internedLeaf(s)).first;
+		}
+		return *it;
+	}
+};
+
+#endif /* INTERN_H_ */
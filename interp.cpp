@@ -0,0 +1,85 @@
+/*
+ * interp.cpp
+ */
+
+#include <sstream>
+#include "interp.h"
+#include "parse.h"
+#include "progcache.h"
+
+Program Program::parse(const string& source, vector<ScriptError> *errors, ProgramCache *cache) {
+	vector<ScriptError> ignored;
+	ParseErrors scope(errors != 0 ? errors : &ignored);
+	Program p;
+	if (cache != 0) {
+		p.tree = cache->get(source);
+	}
+	else {
+		istringstream in(source);
+		int line = 0;
+		p.tree.reset(Prog(&in, &line));
+	}
+	return p;
+}
+
+size_t Program::statements() const {
+	size_t n = 0;
+	for (const ParseTree *l = tree.get(); l != 0; l = l->right) {
+		n++;
+	}
+	return n;
+}
+
+Session::Session() :
+		useArena(true), output(0), out([this](string_view s) {
+			(*output)(s);
+		}), err() {
+}
+
+void Session::set(const string& name, const Value& v) {
+	if (v.hasValue()) {
+		symbols[name] = v;
+	}
+	else {
+		symbols.erase(name);
+	}
+}
+
+Value Session::get(const string& name) const {
+	SymbolTable::const_iterator it = symbols.find(name);
+	return it == symbols.end() ? Value() : it->second;
+}
+
+bool Session::run(const Program& prog, const Output& output, ScriptError *error) {
+	// the empty handle of a source that did not parse
+	if (!prog.valid()) {
+		if (error != 0) {
+			*error = ScriptError { ScriptError::PARSE, 0, "No program to run", 0 };
+		}
+		return false;
+	}
+	this->output = &output;
+	OutputSink *previousOut = OutputSink::active();
+	OutputSink *previousErr = OutputSink::activeError();
+	OutputSink::active() = &out;
+	OutputSink::activeError() = &err;
+	{
+		ExecBudget budget(limits);
+		ExecBudget::Scope scope(limits.any() ? &budget : 0);
+		prog.getTree()->Run(&symbols, useArena ? &arena : 0);
+	}
+	out.flush();
+	OutputSink::active() = previousOut;
+	OutputSink::activeError() = previousErr;
+	// the report is in the error state
+	err.take();
+
+	ErrorState& state = ErrorState::current();
+	if (!state.hasFailed()) {
+		return true;
+	}
+	if (error != 0) {
+		*error = state.getError();
+	}
+	return false;
+}
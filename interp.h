@@ -0,0 +1,106 @@
+/*
+ * interp.h
+ */
+
+#ifndef INTERP_H_
+#define INTERP_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include "value.h"
+#include "arena.h"
+#include "budget.h"
+using namespace std;
+
+class ParseTree;
+class ProgramCache;
+
+// the interface of the interpreter library, libinterp, for a host program
+// that runs scripts in its own process: parse a source into a Program, keep
+// variables in a Session, and run the one against the other.
+
+// errors come back as a ScriptError, from rtError.h, which the command
+// line prints with its text()
+
+// a parsed program. Copies share one parse tree, which never changes, so
+// any number of sessions may run the same program at once on any threads
+class Program {
+	shared_ptr<const ParseTree> tree;
+
+public:
+	Program() {
+	}
+
+	// parses source, counting lines from 0. The handle is empty if the source
+	// does not parse, and every parse error is added to errors when given.
+	// With a cache, a source parsed before is not parsed again
+	static Program parse(const string& source, vector<ScriptError> *errors = 0, ProgramCache *cache = 0);
+
+	bool valid() const {
+		return tree != nullptr;
+	}
+
+	const ParseTree *getTree() const {
+		return tree.get();
+	}
+
+	// the number of top level statements
+	size_t statements() const;
+};
+
+// the variables programs run against, which persist from one run to the
+// next. A session is used by one thread at a time
+class Session {
+public:
+	// receives the output as it is printed, a line at a time
+	typedef function<void(string_view)> Output;
+
+private:
+	SymbolTable symbols;
+	ExecArena arena;
+	bool useArena;
+	ExecBudget::Limits limits;
+	const Output *output;
+	OutputSink out;
+	OutputSink err;
+
+public:
+	Session();
+	Session(const Session&) = delete;
+	Session& operator=(const Session&) = delete;
+
+	// an empty Value unsets the variable
+	void set(const string& name, const Value& v);
+	// an empty Value if the variable is unset
+	Value get(const string& name) const;
+
+	const SymbolTable& variables() const {
+		return symbols;
+	}
+
+	// limits on every later run; the default has none
+	void setLimits(const ExecBudget::Limits& l) {
+		limits = l;
+	}
+
+	// whether runs build their strings in the session's arena; on by default
+	void setArena(bool on) {
+		useArena = on;
+	}
+
+	const ExecArena& getArena() const {
+		return arena;
+	}
+
+	// runs prog against the variables, handing what it prints to output.
+	// Returns false if it stopped at a runtime error, which goes in *error
+	// when given; the variables keep what was assigned before the error. An
+	// empty Program is not run and fails with a parse error
+	bool run(const Program& prog, const Output& output, ScriptError *error = 0);
+};
+
+#endif /* INTERP_H_ */
@@ -7,37 +7,445 @@
 
 #include "tokens.h"
 #include "parse.h"
+#include "stream.h"
+#include "server.h"
+#include "forkserver.h"
+#include "batch.h"
+#include "parallel.h"
+#include "columnar.h"
+#include "reactive.h"
+#include "interp.h"
+#include "stats.h"
+#include <sstream>
 #include <fstream>
 using namespace std;
 
+// --flush=auto, line, exit or a byte count
+static bool flushPolicy(const string& arg) {
+	OutputSink& out = OutputSink::standardOutput();
+	if (arg == "auto") {
+		out.setPolicy(OutputSink::AUTO);
+	}
+	else if (arg == "line") {
+		out.setPolicy(OutputSink::LINE);
+	}
+	else if (arg == "exit") {
+		out.setPolicy(OutputSink::EXIT);
+	}
+	else if (!arg.empty() && arg.size() <= 18 && arg.find_first_not_of("0123456789") == string::npos) {
+		out.setPolicy(OutputSink::BYTES, stoul(arg));
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// runs the program, then reads updates to its inputs from stdin, one line
+// each. An update is itself a script, run against the current inputs; the
+// names whose values it changes are the inputs that changed. The first run
+// and each update with its recomputation get a budget of their own
+static void reactive(ParseTree *prog, const ExecBudget::Limits& limits) {
+	OutputSink& out = OutputSink::standardOutput();
+	OutputSink& err = OutputSink::standardError();
+	ReactiveProgram program(prog);
+	{
+		ExecBudget budget(limits);
+		ExecBudget::Scope scope(limits.any() ? &budget : 0);
+		program.run(out, err);
+	}
+	out.flush();
+
+	string line;
+	while (getline(cin, line)) {
+		ExecBudget budget(limits);
+		ExecBudget::Scope scope(limits.any() ? &budget : 0);
+		istringstream in(line);
+		int linenum = 0;
+		ParseTree *update = Prog(&in, &linenum);
+		if (update == 0) {
+			out.flush();
+			continue;
+		}
+		SymbolTable next = program.getInputs();
+		update->Run(&next);
+		delete update;
+		if (ErrorState::current().hasFailed()) {
+			continue;
+		}
+		set<string> names;
+		for (const pair<const string, Value>& input : program.getInputs()) {
+			names.insert(input.first);
+		}
+		for (const pair<const string, Value>& input : next) {
+			names.insert(input.first);
+		}
+		for (const string& name : names) {
+			SymbolTable::iterator it = next.find(name);
+			program.setInput(name, it == next.end() ? Value() : it->second);
+		}
+		program.recompute(out, err);
+	}
+}
+
+// parses the whole of in, writing any parse errors to stdout
+static Program parse(istream& in, RunStats *stats = 0) {
+	stringstream source;
+	source << in.rdbuf();
+	vector<ScriptError> errors;
+	if (stats != 0) {
+		stats->lex(source.str());
+	}
+	if (stats != 0) {
+		stats->begin();
+	}
+	Program prog = Program::parse(source.str(), &errors);
+	if (stats != 0) {
+		stats->parseSeconds = stats->end(stats->parsePerf);
+		stats->nodes = prog.valid() ? prog.getTree()->NodeCount() : 0;
+	}
+	OutputSink& out = OutputSink::standardOutput();
+	for (const ScriptError& e : errors) {
+		out << e.text() << '\n';
+	}
+	return prog;
+}
+
+// runs prog with its output on stdout and a runtime error on stderr
+static bool run(Session& session, const Program& prog, RunStats *stats = 0) {
+	OutputSink& out = OutputSink::standardOutput();
+	ScriptError error;
+	size_t lines = 0;
+	if (stats != 0) {
+		stats->begin();
+	}
+	bool ok = session.run(prog, [&out, &lines, stats](string_view s) {
+		out << s;
+		if (stats != 0) {
+			lines += count(s.begin(), s.end(), '\n');
+		}
+	}, &error);
+	if (stats != 0) {
+		stats->evalSeconds = stats->end(stats->evalPerf);
+		stats->prints = lines;
+		stats->statements = ok ? prog.statements() : error.completed;
+	}
+	if (ok) {
+		return true;
+	}
+	out.flush();
+	OutputSink& err = OutputSink::standardError();
+	err << error.text() << '\n';
+	err.flush();
+	return false;
+}
+
+static void allocReport(const ExecArena& arena) {
+	OutputSink::standardOutput().flush();
+	cerr << "ALLOCATION REPORT" << endl;
+	cerr << "rope nodes on heap: " << RopeStats::heapNodes << endl;
+	cerr << "string buffers on heap: " << RopeStats::heapTextAllocations << " (" << RopeStats::heapTextBytes
+			<< " bytes)" << endl;
+	cerr << "arena allocations: " << arena.stats.allocations << " (" << arena.stats.bytes << " bytes, "
+			<< arena.stats.chunkMallocs << " chunk mallocs)" << endl;
+	cerr << "nodes promoted to heap: " << RopeStats::promoted << endl;
+	MemoryStats::write(cerr);
+}
+
+// writes the trace to its file when main returns, whichever way it does
+struct TraceFile {
+	ofstream out;
+
+	~TraceFile() {
+		if (out.is_open()) {
+			Trace::disable();
+			Trace::writeChrome(out);
+		}
+	}
+};
+
 int main(int argc, char *argv[]) {
 	ifstream file;
 	istream *in;
 	int linenum = 0;
+	vector<string> filenames;
+	bool batch = false;
+	bool coop = false;
+	size_t quantum = 256;
+	ExecBudget::Limits limits;
+	bool useArena = true;
+	bool report = false;
+	bool stream = false;
+	bool parallel = false;
+	bool incremental = false;
+	char *socketPath = 0;
+	char *forkPath = 0;
+	char *preludePath = 0;
+	char *profilePath = 0;
+	char *tracePath = 0;
+	bool stats = false;
+	bool perf = false;
+	char *statsPath = 0;
+	char *rowsPath = 0;
+	size_t workers = thread::hardware_concurrency();
+	size_t cacheBytes = Server::DEFAULT_CACHE_BYTES;
 
-	if (argc == 1) {
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--alloc-report") {
+			report = true;
+		}
+		else if (arg == "--stream") {
+			stream = true;
+		}
+		else if (arg == "--serve" && i + 1 < argc) {
+			socketPath = argv[++i];
+		}
+		else if (arg == "--fork-serve" && i + 1 < argc) {
+			forkPath = argv[++i];
+		}
+		else if (arg == "--stats") {
+			stats = true;
+		}
+		else if (arg == "--perf") {
+			stats = perf = true;
+		}
+		else if (arg == "--stats-json" && i + 1 < argc) {
+			stats = true;
+			statsPath = argv[++i];
+		}
+		else if (arg == "--profile" && i + 1 < argc) {
+			profilePath = argv[++i];
+		}
+		else if (arg == "--trace" && i + 1 < argc) {
+			tracePath = argv[++i];
+		}
+		else if (arg == "--prelude" && i + 1 < argc) {
+			preludePath = argv[++i];
+		}
+		else if (arg == "--cache-bytes" && i + 1 < argc) {
+			cacheBytes = strtoull(argv[++i], 0, 10);
+		}
+		else if (arg == "--workers" && i + 1 < argc) {
+			workers = atoi(argv[++i]);
+		}
+		else if (arg == "--rows" && i + 1 < argc) {
+			rowsPath = argv[++i];
+		}
+		else if (arg == "--reactive") {
+			incremental = true;
+		}
+		else if (arg == "--parallel") {
+			parallel = true;
+		}
+		else if (arg == "--coop") {
+			batch = coop = true;
+		}
+		else if (arg == "--quantum" && i + 1 < argc) {
+			quantum = strtoul(argv[++i], 0, 10);
+		}
+		else if (arg == "--max-nodes" && i + 1 < argc) {
+			limits.nodes = strtoull(argv[++i], 0, 10);
+		}
+		else if (arg == "--max-time" && i + 1 < argc) {
+			limits.millis = strtoll(argv[++i], 0, 10);
+		}
+		else if (arg == "--max-string-bytes" && i + 1 < argc) {
+			limits.stringBytes = strtoull(argv[++i], 0, 10);
+		}
+		else if (arg == "--batch") {
+			batch = true;
+		}
+		else if (arg == "--manifest" && i + 1 < argc) {
+			batch = true;
+			if (!BatchRunner::readManifest(argv[++i], filenames)) {
+				cerr << "COULD NOT OPEN " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--no-arena") {
+			useArena = false;
+		}
+		else if (arg.compare(0, 8, "--flush=") == 0) {
+			if (!flushPolicy(arg.substr(8))) {
+				cerr << "INVALID FLUSH POLICY " << arg.substr(8) << endl;
+				return 1;
+			}
+		}
+		else {
+			filenames.push_back(argv[i]);
+		}
+	}
+
+	if (report) {
+		MemoryStats::enable();
+	}
+
+	TraceFile trace;
+	if (tracePath != 0) {
+		trace.out.open(tracePath);
+		if (!trace.out.is_open()) {
+			cerr << "COULD NOT OPEN " << tracePath << endl;
+			return 1;
+		}
+		Trace::enable();
+	}
+
+	if (batch) {
+		BatchRunner runner(filenames, limits);
+		size_t failed = coop ? runner.runCoroutines(workers, quantum) : runner.run(workers);
+		// a script that did not open, parse or run to the end fails the batch
+		return failed == 0 ? 0 : 1;
+	}
+
+	if (filenames.size() > 1) {
+		cerr << "TOO MANY FILENAMES" << endl;
+		return 1;
+	}
+
+	if (socketPath != 0) {
+		Server server(socketPath, workers, limits, cacheBytes);
+		if (!server.start()) {
+			return 1;
+		}
+		server.run();
+	}
+
+	ifstream preludeFile;
+	if (preludePath != 0) {
+		preludeFile.open(preludePath);
+		if (!preludeFile.is_open()) {
+			cerr << "COULD NOT OPEN " << preludePath << endl;
+			return 1;
+		}
+	}
+
+	if (forkPath != 0) {
+		if (preludePath == 0) {
+			cerr << "FORK SERVER NEEDS A PRELUDE" << endl;
+			return 1;
+		}
+		ForkServer server(forkPath, limits);
+		if (!server.start(&preludeFile)) {
+			return 1;
+		}
+		server.run();
+	}
+
+	if (filenames.empty()) {
+		if (incremental) {
+			cerr << "REACTIVE MODE NEEDS A FILENAME" << endl;
+			return 1;
+		}
 		in = &cin;
 	}
 
-	else if (argc == 2) {
-		file.open(argv[1]);
+	else {
+		file.open(filenames[0]);
 		if (file.is_open() == false) {
-			cerr << "COULD NOT OPEN " << argv[1] << endl;
+			cerr << "COULD NOT OPEN " << filenames[0] << endl;
 			return 1;
 		}
 		in = &file;
 	}
 
-	else {
-		cerr << "TOO MANY FILENAMES" << endl;
+	// columnar rows and parallel statements are not charged to a budget
+	if (limits.any() && !stream && !incremental && (rowsPath != 0 || parallel)) {
+		cerr << "LIMITS ARE NOT SUPPORTED WITH " << (rowsPath != 0 ? "--rows" : "--parallel") << endl;
 		return 1;
 	}
 
-	ParseTree *prog = Prog(in, &linenum);
+	static ExecArena arena;
+
+	if (stream) {
+		StreamRunner runner;
+		runner.run(in, &linenum, useArena ? &arena : 0, limits);
+	}
+	else if (incremental || rowsPath != 0 || parallel) {
+		ParseTree *prog = Prog(in, &linenum);
+
+		if (prog == 0) {
+			return 0;
+		}
 
-	if (prog == 0) {
+		if (incremental) {
+			reactive(prog, limits);
+		}
+		else if (rowsPath != 0) {
+			ifstream rows(rowsPath);
+			if (!rows.is_open()) {
+				cerr << "COULD NOT OPEN " << rowsPath << endl;
+				return 1;
+			}
+			ColumnarRunner runner(prog);
+			runner.run(rows);
+		}
+		else {
+			SymbolTable symbols;
+			ParallelRunner runner(prog, &symbols);
+			runner.run(workers);
+		}
+	}
+	else {
+		// a plain run goes through the library like any other host
+		Session session;
+		session.setArena(useArena);
+		unique_ptr<PerfCounters> counters(perf ? new PerfCounters() : 0);
+		RunStats runStats(counters.get());
+		Program prog = parse(*in, stats ? &runStats : 0);
+		if (!prog.valid()) {
+			return 0;
+		}
+		// a cold start of what --fork-serve does warm
+		if (preludePath != 0) {
+			Program prelude = parse(preludeFile);
+			if (!prelude.valid() || !run(session, prelude)) {
+				return 0;
+			}
+		}
+		session.setLimits(limits);
+		ofstream profileFile;
+		if (profilePath != 0) {
+			profileFile.open(profilePath);
+			if (!profileFile.is_open()) {
+				cerr << "COULD NOT OPEN " << profilePath << endl;
+				return 1;
+			}
+		}
+		Profiler profiler(profilePath != 0 ? prog.getTree()->NodeCount() : 0);
+		{
+			Profiler::Scope scope(profilePath != 0 ? &profiler : 0);
+			run(session, prog, stats ? &runStats : 0);
+		}
+		if (profilePath != 0) {
+			OutputSink::standardOutput().flush();
+			cerr << "PROFILE REPORT" << endl;
+			profiler.writeReport(cerr);
+			profiler.writeCollapsed(profileFile);
+		}
+		if (report) {
+			allocReport(session.getArena());
+		}
+		if (stats) {
+			runStats.symbols = session.variables().size();
+			runStats.measureRss();
+			OutputSink::standardOutput().flush();
+			if (statsPath == 0) {
+				runStats.writeText(cerr);
+			}
+			else {
+				ofstream json(statsPath);
+				if (!json.is_open()) {
+					cerr << "COULD NOT OPEN " << statsPath << endl;
+					return 1;
+				}
+				runStats.writeJson(json);
+			}
+		}
 		return 0;
 	}
-	prog->Eval();
 
+	if (report) {
+		allocReport(arena);
+	}
 }
@@ -0,0 +1,275 @@
+/*
+ * memory.h
+ */
+
+#ifndef MEMORY_H_
+#define MEMORY_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <cstdlib>
+#include <ostream>
+#include <cxxabi.h>
+using namespace std;
+
+// the allocations of one kind that are live, in number and bytes, and the
+// most of each there have been at once. Gauges are shared by every thread,
+// so that a node parsed on one thread and freed on another is still counted
+// once
+class MemoryGauge {
+	atomic<size_t> count;
+	atomic<size_t> bytes;
+	atomic<size_t> peakCount;
+	atomic<size_t> peakBytes;
+
+public:
+	MemoryGauge() :
+			count(0), bytes(0), peakCount(0), peakBytes(0) {
+	}
+
+	void add(size_t n) {
+		raise(peakCount, count.fetch_add(1, memory_order_relaxed) + 1);
+		raise(peakBytes, bytes.fetch_add(n, memory_order_relaxed) + n);
+	}
+
+	// n bytes over allocations allocations
+	void remove(size_t n, size_t allocations = 1) {
+		count.fetch_sub(allocations, memory_order_relaxed);
+		bytes.fetch_sub(n, memory_order_relaxed);
+	}
+
+	// "<count> (<bytes> bytes), peak <count> (<bytes> bytes)"
+	void write(ostream& out) const {
+		out << count.load(memory_order_relaxed) << " (" << bytes.load(memory_order_relaxed) << " bytes), peak "
+				<< peakCount.load(memory_order_relaxed) << " (" << peakBytes.load(memory_order_relaxed) << " bytes)";
+	}
+
+	static void raise(atomic<size_t>& peak, size_t value) {
+		size_t p = peak.load(memory_order_relaxed);
+		while (value > p && !peak.compare_exchange_weak(p, value, memory_order_relaxed)) {
+		}
+	}
+};
+
+// what --alloc-report accounts for while the process runs: parse tree nodes,
+// in total and by type; the rope nodes and characters behind string Values,
+// on the heap or in an arena; the nodes of symbol tables; and the
+// allocations the Value operators make on the way to a result.
+//
+// Nothing is counted until enable(), which comes before anything is
+// allocated, so that a run without the report touches no shared counter,
+// only a load and a branch at each place that would count
+struct MemoryStats {
+	static const int KINDS = 32;
+
+	// one type of parse tree node. Entry 0 stands for nodes that were not
+	// counted, such as those built by hand outside the parser
+	struct Kind {
+		const type_info *type;
+		size_t size;
+		MemoryGauge gauge;
+	};
+
+	static inline atomic<bool> counting { false };
+	static inline MemoryGauge nodes;
+	static inline MemoryGauge strings;
+	static inline MemoryGauge symbols;
+
+	// made while a Value operator ran: in number and bytes over the life of
+	// the process, and the most bytes a single operator made
+	static inline atomic<size_t> temporaries { 0 };
+	static inline atomic<size_t> temporaryBytes { 0 };
+	static inline atomic<size_t> largestTemporary { 0 };
+
+	// the bytes made so far by the operator running on this thread, if any
+	class OperatorScope {
+		size_t bytes;
+		OperatorScope *previous;
+
+	public:
+		OperatorScope() :
+				bytes(0), previous(0) {
+			if (__builtin_expect(enabled(), 0)) {
+				previous = active();
+				active() = this;
+			}
+		}
+		~OperatorScope() {
+			if (__builtin_expect(enabled(), 0)) {
+				active() = previous;
+				MemoryGauge::raise(largestTemporary, bytes);
+			}
+		}
+
+		static OperatorScope *&active() {
+			static thread_local OperatorScope *scope = nullptr;
+			return scope;
+		}
+
+		static void count(size_t n) {
+			if (!enabled()) {
+				return;
+			}
+			if (OperatorScope *scope = active()) {
+				temporaries.fetch_add(1, memory_order_relaxed);
+				temporaryBytes.fetch_add(n, memory_order_relaxed);
+				scope->bytes += n;
+			}
+		}
+	};
+
+	static bool enabled() {
+		return counting.load(memory_order_relaxed);
+	}
+
+	static void enable() {
+		counting.store(true, memory_order_relaxed);
+	}
+
+	// the entry that nodes of type T are counted under
+	template<class T>
+	static int kindOf() {
+		static const int kind = addKind(typeid(T), sizeof(T));
+		return kind;
+	}
+
+	static void addNode(int kind) {
+		if (kind != 0) {
+			nodes.add(kinds()[kind].size);
+			kinds()[kind].gauge.add(kinds()[kind].size);
+		}
+	}
+
+	static void removeNode(int kind) {
+		if (kind != 0) {
+			nodes.remove(kinds()[kind].size);
+			kinds()[kind].gauge.remove(kinds()[kind].size);
+		}
+	}
+
+	static void addString(size_t n) {
+		if (enabled()) {
+			strings.add(n);
+			OperatorScope::count(n);
+		}
+	}
+
+	static void removeString(size_t n, size_t allocations = 1) {
+		if (enabled()) {
+			strings.remove(n, allocations);
+		}
+	}
+
+	static void write(ostream& out) {
+		out << "parse tree nodes: ";
+		nodes.write(out);
+		out << endl;
+		int n = kindCount().load(memory_order_acquire);
+		for (int k = 1; k < n; k++) {
+			out << "  " << demangle(*kinds()[k].type) << ": ";
+			kinds()[k].gauge.write(out);
+			out << endl;
+		}
+		out << "string values: ";
+		strings.write(out);
+		out << endl;
+		out << "symbol table nodes: ";
+		symbols.write(out);
+		out << endl;
+		out << "value operator allocations: " << temporaries.load(memory_order_relaxed) << " ("
+				<< temporaryBytes.load(memory_order_relaxed) << " bytes), at most "
+				<< largestTemporary.load(memory_order_relaxed) << " bytes in one operator" << endl;
+	}
+
+private:
+	static Kind *kinds() {
+		static Kind table[KINDS];
+		return table;
+	}
+
+	static atomic<int>& kindCount() {
+		static atomic<int> count(1);
+		return count;
+	}
+
+	// types past the table's room share entry 0 and go uncounted
+	static int addKind(const type_info& type, size_t size) {
+		static mutex lock;
+		lock_guard<mutex> guard(lock);
+		int kind = kindCount().load(memory_order_relaxed);
+		if (kind == KINDS) {
+			return 0;
+		}
+		kinds()[kind].type = &type;
+		kinds()[kind].size = size;
+		kindCount().store(kind + 1, memory_order_release);
+		return kind;
+	}
+
+	static string demangle(const type_info& type) {
+		int status;
+		char *name = abi::__cxa_demangle(type.name(), 0, 0, &status);
+		string s = status == 0 ? name : type.name();
+		free(name);
+		return s;
+	}
+};
+
+// an allocator that counts what it holds through Account, which has static
+// add(bytes) and remove(bytes)
+template<class T, class Account>
+struct CountingAllocator {
+	typedef T value_type;
+
+	CountingAllocator() {
+	}
+	template<class U>
+	CountingAllocator(const CountingAllocator<U, Account>&) {
+	}
+
+	T *allocate(size_t n) {
+		Account::add(n * sizeof(T));
+		return allocator<T>().allocate(n);
+	}
+	void deallocate(T *p, size_t n) {
+		Account::remove(n * sizeof(T));
+		allocator<T>().deallocate(p, n);
+	}
+
+	template<class U>
+	bool operator==(const CountingAllocator<U, Account>&) const {
+		return true;
+	}
+	template<class U>
+	bool operator!=(const CountingAllocator<U, Account>&) const {
+		return false;
+	}
+};
+
+// the accounts allocators can count in
+struct StringAccount {
+	static void add(size_t n) {
+		MemoryStats::addString(n);
+	}
+	static void remove(size_t n) {
+		MemoryStats::removeString(n);
+	}
+};
+
+struct SymbolAccount {
+	static void add(size_t n) {
+		if (MemoryStats::enabled()) {
+			MemoryStats::symbols.add(n);
+		}
+	}
+	static void remove(size_t n) {
+		if (MemoryStats::enabled()) {
+			MemoryStats::symbols.remove(n);
+		}
+	}
+};
+
+#endif /* MEMORY_H_ */
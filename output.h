@@ -0,0 +1,214 @@
+/*
+ * output.h
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <functional>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+using namespace std;
+
+// buffered writer for program output. print used to go through cout and endl,
+// which is one write syscall per line; the sink collects output in a user
+// space buffer and writes it according to its policy:
+//   AUTO   line buffered when the descriptor is a terminal, otherwise BYTES
+//   LINE   written at the end of every line
+//   BYTES  written whenever threshold bytes are pending
+//   EXIT   held until flush() is called or the sink is destroyed at exit
+// Anything that writes to stderr flushes the sink first, so that the two
+// streams stay in order. A sink made without a descriptor only collects its
+// output for the caller to take(), unless it is given a callback to hand its
+// writes to instead. A sink given a frame tag sends each write
+// as "<tag> <length>\n" followed by the bytes, so that several sinks can
+// share one socket
+class OutputSink {
+public:
+	enum Policy {
+		AUTO, LINE, BYTES, EXIT
+	};
+
+	static const size_t DEFAULT_THRESHOLD = 64 * 1024;
+
+private:
+	int fd;
+	Policy policy;
+	size_t threshold;
+	bool lineBuffered;
+	char tag;
+	function<void(string_view)> callback;
+	string buf;
+
+public:
+	OutputSink(int fd, Policy policy = AUTO, size_t threshold = DEFAULT_THRESHOLD) :
+			fd(fd), policy(AUTO), threshold(threshold), lineBuffered(false), tag(0) {
+		setPolicy(policy, threshold);
+	}
+	OutputSink(function<void(string_view)> callback, Policy policy = LINE, size_t threshold = DEFAULT_THRESHOLD) :
+			fd(-1), policy(AUTO), threshold(threshold), lineBuffered(false), tag(0), callback(std::move(callback)) {
+		setPolicy(policy, threshold);
+	}
+	OutputSink() :
+			fd(-1), policy(EXIT), threshold(DEFAULT_THRESHOLD), lineBuffered(false), tag(0) {
+	}
+	~OutputSink() {
+		flush();
+	}
+	OutputSink(const OutputSink&) = delete;
+	OutputSink& operator=(const OutputSink&) = delete;
+
+	void setPolicy(Policy p, size_t n = DEFAULT_THRESHOLD) {
+		flush();
+		policy = p;
+		threshold = n ? n : 1;
+		lineBuffered = p == LINE || (p == AUTO && isatty(fd));
+		buf.reserve(threshold);
+	}
+
+	Policy getPolicy() const {
+		return policy;
+	}
+
+	void setFrameTag(char t) {
+		flush();
+		tag = t;
+	}
+
+	void write(const char *s, size_t n) {
+		if (policy != EXIT && buf.size() + n > threshold) {
+			flush();
+			// too big to be worth copying through the buffer
+			if (n >= threshold) {
+				emit(s, n);
+				return;
+			}
+		}
+		buf.append(s, n);
+	}
+
+	OutputSink& operator<<(string_view s) {
+		write(s.data(), s.size());
+		return *this;
+	}
+	OutputSink& operator<<(const char *s) {
+		return *this << string_view(s);
+	}
+	OutputSink& operator<<(const string& s) {
+		return *this << string_view(s);
+	}
+
+	// a newline completes a line, which is where a line buffered sink writes
+	OutputSink& operator<<(char c) {
+		if (policy != EXIT && buf.size() + 1 > threshold) {
+			flush();
+		}
+		buf.push_back(c);
+		if (c == '\n' && lineBuffered) {
+			flush();
+		}
+		return *this;
+	}
+
+	OutputSink& operator<<(long long v) {
+		char digits[24];
+		to_chars_result r = to_chars(digits, digits + sizeof digits, v);
+		write(digits, r.ptr - digits);
+		return *this;
+	}
+	OutputSink& operator<<(int v) {
+		return *this << (long long) v;
+	}
+
+	void flush() {
+		if ((fd >= 0 || callback) && !buf.empty()) {
+			emit(buf.data(), buf.size());
+			buf.clear();
+		}
+	}
+
+	// hands over what has been collected and not yet written
+	string take() {
+		string s;
+		s.swap(buf);
+		return s;
+	}
+
+	// the sink for the process's stdout, flushed when the program exits
+	static OutputSink& standardOutput() {
+		static OutputSink out(STDOUT_FILENO);
+		return out;
+	}
+
+	// the sink for the process's stderr, written at the end of every line
+	static OutputSink& standardError() {
+		static OutputSink err(STDERR_FILENO, LINE);
+		return err;
+	}
+
+	// where print writes on this thread
+	static OutputSink *&active() {
+		static thread_local OutputSink *sink = &standardOutput();
+		return sink;
+	}
+
+	// where runtime errors are reported on this thread
+	static OutputSink *&activeError() {
+		static thread_local OutputSink *sink = &standardError();
+		return sink;
+	}
+
+private:
+	void emit(const char *s, size_t n) {
+		if (callback) {
+			callback(string_view(s, n));
+			return;
+		}
+		if (!tag) {
+			writeAll(s, n);
+			return;
+		}
+		char header[32];
+		header[0] = tag;
+		header[1] = ' ';
+		char *end = to_chars(header + 2, header + sizeof header - 1, n).ptr;
+		*end++ = '\n';
+		// header and payload in one syscall, finishing with write if short
+		size_t h = end - header;
+		iovec parts[2] = { { header, h }, { const_cast<char *>(s), n } };
+		ssize_t w;
+		do {
+			w = writev(fd, parts, 2);
+		} while (w < 0 && errno == EINTR);
+		if (w < 0) {
+			return;
+		}
+		size_t done = w;
+		if (done < h) {
+			writeAll(header + done, h - done);
+			done = h;
+		}
+		writeAll(s + (done - h), n - (done - h));
+	}
+
+	void writeAll(const char *s, size_t n) {
+		while (n > 0) {
+			ssize_t w = ::write(fd, s, n);
+			if (w < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				// nowhere left to report it; drop the output like a closed pipe
+				return;
+			}
+			s += w;
+			n -= w;
+		}
+	}
+};
+
+#endif /* OUTPUT_H_ */
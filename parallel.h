@@ -0,0 +1,225 @@
+/*
+ * parallel.h
+ */
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <climits>
+#include "parse.h"
+#include "threadpool.h"
+using namespace std;
+
+// runs the top level statements of a program concurrently where they do not
+// depend on each other. Every statement's read and write sets give the
+// edges of a dependency graph: a statement waits for the last earlier
+// statement that wrote anything it reads or writes, and for every earlier
+// statement that read something it writes since that write. A statement
+// starts once everything it waits for is done.
+//
+// Output is collected per statement and written out in program order, and
+// the first runtime error in program order ends the output exactly where a
+// sequential run would stop. The output of statements after it that had
+// already run is dropped; those not yet started are skipped.
+//
+// The symbol table gets an empty entry for every name up front, so that
+// running statements never change its shape, only the values of entries
+// that no other running statement touches. Statements after the first
+// error may still have assigned, so the table is only as a sequential run
+// would leave it up to that error. Strings stay on the heap, since a value
+// made by one thread is read by others
+class ParallelRunner {
+	struct Statement {
+		const StmtList *link;
+		vector<size_t> successors;
+		atomic<size_t> waiting;
+		string out;
+		string err;
+		bool failed;
+		bool done;
+
+		Statement() :
+				link(0), waiting(0), failed(false), done(false) {
+		}
+	};
+
+	ParseTree *prog;
+	vector<Statement> statements;
+	SymbolTable *symbolTable;
+	ThreadPool *pool;
+
+	// index of the first statement known to have failed
+	atomic<size_t> firstFailure;
+
+	mutex lock;
+	condition_variable finished;
+
+public:
+	ParallelRunner(ParseTree *prog, SymbolTable *symbolTable) :
+			prog(prog), symbolTable(symbolTable), pool(0), firstFailure(SIZE_MAX) {
+	}
+
+	void run(size_t workers) {
+		size_t n = 0;
+		for (ParseTree *l = prog; l != 0; l = l->right) {
+			n++;
+		}
+		// statements hold atomics, so the vector is sized once and never grows
+		vector<Statement> list(n);
+		statements.swap(list);
+		n = 0;
+		for (ParseTree *l = prog; l != 0; l = l->right) {
+			statements[n++].link = static_cast<const StmtList *>(l);
+		}
+		analyze();
+
+		// the roots are found before any is submitted: once one runs, its
+		// successors can reach zero and be submitted by the worker
+		vector<size_t> roots;
+		for (size_t i = 0; i < statements.size(); i++) {
+			if (statements[i].waiting.load() == 0) {
+				roots.push_back(i);
+			}
+		}
+		ThreadPool threads(workers);
+		pool = &threads;
+		for (size_t i : roots) {
+			submit(i);
+		}
+
+		OutputSink& out = *OutputSink::active();
+		OutputSink& err = *OutputSink::activeError();
+		for (size_t i = 0; i < statements.size(); i++) {
+			Statement& s = statements[i];
+			{
+				unique_lock<mutex> guard(lock);
+				finished.wait(guard, [&s] {
+					return s.done;
+				});
+			}
+			out << s.out;
+			if (s.failed) {
+				out.flush();
+				err << s.err;
+				err.flush();
+				break;
+			}
+		}
+		threads.wait();
+		pool = 0;
+
+		// names that were never assigned go again
+		for (SymbolTable::iterator it = symbolTable->begin(); it != symbolTable->end();) {
+			if (it->second.hasValue()) {
+				it++;
+			}
+			else {
+				it = symbolTable->erase(it);
+			}
+		}
+	}
+
+private:
+	void analyze() {
+		map<const string *, size_t> lastWrite;
+		map<const string *, vector<size_t>> readsSinceWrite;
+
+		for (size_t i = 0; i < statements.size(); i++) {
+			set<const string *> reads, writes;
+			statements[i].link->left->Access(reads, writes);
+
+			set<size_t> before;
+			for (const string *id : reads) {
+				map<const string *, size_t>::iterator w = lastWrite.find(id);
+				if (w != lastWrite.end()) {
+					before.insert(w->second);
+				}
+			}
+			for (const string *id : writes) {
+				map<const string *, size_t>::iterator w = lastWrite.find(id);
+				if (w != lastWrite.end()) {
+					before.insert(w->second);
+				}
+				vector<size_t>& readers = readsSinceWrite[id];
+				before.insert(readers.begin(), readers.end());
+			}
+			before.erase(i);
+
+			for (const string *id : reads) {
+				readsSinceWrite[id].push_back(i);
+			}
+			for (const string *id : writes) {
+				lastWrite[id] = i;
+				readsSinceWrite[id].clear();
+			}
+			for (size_t b : before) {
+				statements[b].successors.push_back(i);
+			}
+			statements[i].waiting.store(before.size());
+
+			for (const string *id : reads) {
+				(*symbolTable)[*id];
+			}
+			for (const string *id : writes) {
+				(*symbolTable)[*id];
+			}
+		}
+	}
+
+	void submit(size_t i) {
+		pool->submit([this, i] {
+			execute(i);
+		});
+	}
+
+	void execute(size_t i) {
+		Statement& s = statements[i];
+		if (i < firstFailure.load()) {
+			OutputSink out, err;
+			OutputSink *previousOut = OutputSink::active();
+			OutputSink *previousErr = OutputSink::activeError();
+			OutputSink::active() = &out;
+			OutputSink::activeError() = &err;
+
+			ErrorState& state = ErrorState::current();
+			state.clear();
+			try {
+				s.link->EvalHead(symbolTable);
+			}
+			catch (RuntimeError& e) {
+				state.record(e);
+			}
+
+			OutputSink::active() = previousOut;
+			OutputSink::activeError() = previousErr;
+			s.out = out.take();
+			s.err = err.take();
+			if (state.hasFailed()) {
+				s.failed = true;
+				size_t first = firstFailure.load();
+				while (i < first && !firstFailure.compare_exchange_weak(first, i)) {
+				}
+			}
+		}
+
+		for (size_t next : s.successors) {
+			if (--statements[next].waiting == 0) {
+				submit(next);
+			}
+		}
+		{
+			lock_guard<mutex> guard(lock);
+			s.done = true;
+		}
+		finished.notify_all();
+	}
+};
+
+#endif /* PARALLEL_H_ */
@@ -7,9 +7,10 @@
 
 #include "parse.h"
 
+// parser state is per thread, so that several programs can be parsed at once
 namespace Parser {
-bool pushed_back = false;
-Token pushed_token;
+thread_local bool pushed_back = false;
+thread_local Token pushed_token;
 
 static Token GetNextToken(istream *in, int *line) {
 	if (pushed_back) {
@@ -29,25 +30,70 @@ static void PushBackToken(Token& t) {
 
 }
 
-static int error_count = 0;
+// allocates a T and counts it by type in MemoryStats
+template<class T, class ... Args>
+static T *make(Args&&... args) {
+	T *node = new T(std::forward<Args>(args)...);
+	node->Count(MemoryStats::kindOf<T>());
+	return node;
+}
+
+static thread_local int error_count = 0;
 
 void ParseError(int line, string msg) {
 	++error_count;
-	cout << line << ": " << msg << endl;
+	ScriptError e { ScriptError::PARSE, line, std::move(msg), 0 };
+	if (vector<ScriptError> *errors = ParseErrors::active()) {
+		errors->push_back(std::move(e));
+	}
+	else {
+		*OutputSink::active() << e.text() << '\n';
+	}
 }
 
 ParseTree *Prog(istream *in, int *line) {
+	// a thread may parse many programs; only this one's errors count
+	TRACE_SPAN(PARSE, -1);
+	int errors = error_count;
+	Parser::pushed_back = false;
+
 	ParseTree *sl = Slist(in, line);
 
 	if (sl == 0)
 		ParseError(*line, "No statements in program");
 
-	if (error_count)
+	if (error_count != errors)
 		return 0;
 
 	return sl;
 }
 
+// parses the next statement and its semicolon, for running a program while
+// it is still being read. The statement comes back wrapped in a one element
+// StmtList so that it runs exactly as it would inside the whole program.
+// Returns 0 at the end of the input, or after a parse error has been
+// reported, in which case *failed is set. first marks the start of the
+// program, where an empty input or a first statement that does not parse
+// also reports that there are no statements, as Prog does
+ParseTree *NextStmt(istream *in, int *line, bool first, bool *failed) {
+	int errors = error_count;
+	ParseTree *s = Stmt(in, line);
+	if (s != 0 && Parser::GetNextToken(in, line) != SC) {
+		ParseError(*line, "Missing semicolon");
+		delete s;
+		s = 0;
+	}
+	if (s == 0) {
+		if (first)
+			ParseError(*line, "No statements in program");
+		*failed = error_count != errors;
+		return 0;
+	}
+
+	*failed = false;
+	return make<StmtList>(s, nullptr);
+}
+
 // Slist is a Statement followed by a Statement List
 ParseTree *Slist(istream *in, int *line) {
 	ParseTree *s = Stmt(in, line);
@@ -59,7 +105,7 @@ ParseTree *Slist(istream *in, int *line) {
 		return 0;
 	}
 
-	return new StmtList(s, Slist(in, line));
+	return make<StmtList>(s, Slist(in, line));
 }
 
 ParseTree *Stmt(istream *in, int *line) {
@@ -116,7 +162,7 @@ ParseTree *IfStmt(istream *in, int *line) {
 		return 0;
 	}
 
-	return new IfStatement(t.GetLinenum(), ex, stmt);
+	return make<IfStatement>(t.GetLinenum(), ex, stmt);
 }
 
 ParseTree *PrintStmt(istream *in, int *line) {
@@ -128,7 +174,7 @@ ParseTree *PrintStmt(istream *in, int *line) {
 		return 0;
 	}
 
-	return new PrintStatement(l, ex);
+	return make<PrintStatement>(l, ex);
 }
 
 ParseTree *Expr(istream *in, int *line) {
@@ -150,7 +196,7 @@ ParseTree *Expr(istream *in, int *line) {
 		return 0;
 	}
 
-	return new Assignment(t.GetLinenum(), t1, t2);
+	return make<Assignment>(t.GetLinenum(), t1, t2);
 }
 
 ParseTree *LogicExpr(istream *in, int *line) {
@@ -174,9 +220,9 @@ ParseTree *LogicExpr(istream *in, int *line) {
 		}
 
 		if (t == LOGICAND)
-			t1 = new LogicAndExpr(t.GetLinenum(), t1, t2);
+			t1 = make<LogicAndExpr>(t.GetLinenum(), t1, t2);
 		else
-			t1 = new LogicOrExpr(t.GetLinenum(), t1, t2);
+			t1 = make<LogicOrExpr>(t.GetLinenum(), t1, t2);
 	}
 }
 
@@ -202,22 +248,22 @@ ParseTree *CompareExpr(istream *in, int *line) {
 
 		switch (t.GetTokenType()) {
 		case EQ:
-			t1 = new EqExpr(t.GetLinenum(), t1, t2);
+			t1 = make<EqExpr>(t.GetLinenum(), t1, t2);
 			break;
 		case NEQ:
-			t1 = new NEqExpr(t.GetLinenum(), t1, t2);
+			t1 = make<NEqExpr>(t.GetLinenum(), t1, t2);
 			break;
 		case GT:
-			t1 = new GtExpr(t.GetLinenum(), t1, t2);
+			t1 = make<GtExpr>(t.GetLinenum(), t1, t2);
 			break;
 		case GEQ:
-			t1 = new GEqExpr(t.GetLinenum(), t1, t2);
+			t1 = make<GEqExpr>(t.GetLinenum(), t1, t2);
 			break;
 		case LT:
-			t1 = new LtExpr(t.GetLinenum(), t1, t2);
+			t1 = make<LtExpr>(t.GetLinenum(), t1, t2);
 			break;
 		case LEQ:
-			t1 = new LEqExpr(t.GetLinenum(), t1, t2);
+			t1 = make<LEqExpr>(t.GetLinenum(), t1, t2);
 			break;
 		default:
 			break;
@@ -246,9 +292,9 @@ ParseTree *AddExpr(istream *in, int *line) {
 		}
 
 		if (t == PLUS)
-			t1 = new PlusExpr(t.GetLinenum(), t1, t2);
+			t1 = make<PlusExpr>(t.GetLinenum(), t1, t2);
 		else
-			t1 = new MinusExpr(t.GetLinenum(), t1, t2);
+			t1 = make<MinusExpr>(t.GetLinenum(), t1, t2);
 	}
 }
 
@@ -273,9 +319,9 @@ ParseTree *MulExpr(istream *in, int *line) {
 		}
 
 		if (t == STAR)
-			t1 = new TimesExpr(t.GetLinenum(), t1, t2);
+			t1 = make<TimesExpr>(t.GetLinenum(), t1, t2);
 		else
-			t1 = new DivideExpr(t.GetLinenum(), t1, t2);
+			t1 = make<DivideExpr>(t.GetLinenum(), t1, t2);
 	}
 }
 
@@ -297,7 +343,7 @@ ParseTree *Factor(istream *in, int *line) {
 	}
 
 	if (neg) {
-		return new TimesExpr(t.GetLinenum(), new IConst(t.GetLinenum(), -1), p1);
+		return make<TimesExpr>(t.GetLinenum(), make<IConst>(t.GetLinenum(), -1), p1);
 	}
 	else {
 		return p1;
@@ -308,19 +354,19 @@ ParseTree *Primary(istream *in, int *line) {
 	Token t = Parser::GetNextToken(in, line);
 
 	if (t == IDENT) {
-		return new Ident(t);
+		return make<Ident>(t);
 	}
 	else if (t == ICONST) {
-		return new IConst(t);
+		return make<IConst>(t);
 	}
 	else if (t == SCONST) {
-		return new SConst(t);
+		return make<SConst>(t);
 	}
 	else if (t == TRUE) {
-		return new BoolConst(t, true);
+		return make<BoolConst>(t, true);
 	}
 	else if (t == FALSE) {
-		return new BoolConst(t, false);
+		return make<BoolConst>(t, false);
 	}
 	else if (t == LPAREN) {
 		ParseTree *ex = Expr(in, line);
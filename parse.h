@@ -8,11 +8,32 @@
 #include <iostream>
 using namespace std;
 
+#include <vector>
 #include "tokens.h"
 #include "parsetree.h"
 
+// while a list is active on the thread, parse errors are added to it instead
+// of being printed as "line: message"
+class ParseErrors {
+	vector<ScriptError> *previous;
+
+public:
+	ParseErrors(vector<ScriptError> *errors) :
+			previous(active()) {
+		active() = errors;
+	}
+	~ParseErrors() {
+		active() = previous;
+	}
+
+	static vector<ScriptError> *&active() {
+		static thread_local vector<ScriptError> *errors = nullptr;
+		return errors;
+	}
+};
 
 extern ParseTree *Prog(istream *in, int *line);
+extern ParseTree *NextStmt(istream *in, int *line, bool first, bool *failed);
 extern ParseTree *Slist(istream *in, int *line);
 extern ParseTree *Stmt(istream *in, int *line);
 extern ParseTree *IfStmt(istream *in, int *line);
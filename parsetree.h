@@ -7,11 +7,19 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include "value.h"
+#include "intern.h"
 #include "rtError.h"
+#include "column.h"
+#include "budget.h"
+#include "profile.h"
+#include "memory.h"
+#include "trace.h"
 
 using std::vector;
 using std::map;
+using std::set;
 
 // NodeType represents all possible types
 enum NodeType {
@@ -20,6 +28,8 @@ enum NodeType {
 
 class ParseTree {
 	int linenum;
+	// the MemoryStats entry this node is counted under, 0 if it is not
+	int kind;
 
 public:
 
@@ -27,13 +37,23 @@ public:
 	ParseTree *right;
 
 	ParseTree(int linenum, ParseTree *l = 0, ParseTree *r = 0) :
-			linenum(linenum), left(l), right(r) {
+			linenum(linenum), kind(0), left(l), right(r) {
 
 	}
 
 	virtual ~ParseTree() {
 		delete left;
 		delete right;
+		MemoryStats::removeNode(kind);
+	}
+
+	// counts this node in MemoryStats under kind, the entry of its type,
+	// when the accounting is on
+	void Count(int kind) {
+		if (MemoryStats::enabled()) {
+			this->kind = kind;
+			MemoryStats::addNode(kind);
+		}
 	}
 
 	int GetLinenum() const {
@@ -55,6 +75,15 @@ public:
 		return lc;
 	}
 
+	int NodeCount() const {
+		int nc = 1;
+		if (left)
+			nc += left->NodeCount();
+		if (right)
+			nc += right->NodeCount();
+		return nc;
+	}
+
 	virtual bool IsIdent() const {
 		return false;
 	}
@@ -69,416 +98,652 @@ public:
 		return false;
 	}
 
-	virtual string GetId() const {
-		return "";
+	virtual const string& GetId() const {
+		static const string none;
+		return none;
+	}
+
+	// adds the identifiers this node reads and assigns, including those of
+	// the nodes below it. An assignment under an if counts as a write even
+	// though it may not happen
+	virtual void Access(set<const string *>& reads, set<const string *>& writes) const {
+		if (left)
+			left->Access(reads, writes);
+		if (right)
+			right->Access(reads, writes);
+	}
+
+	// runs the program against the persistent symbol table
+	virtual Value Eval(ExecArena *arena = 0) {
+		static SymbolTable symbolTable;
+		return Run(&symbolTable, arena);
+	}
+
+	// runs the program against symbolTable. Strings built along the way are
+	// allocated from arena, when one is given; the values that survive in the
+	// symbol table are promoted to the heap before the arena is rewound. A
+	// runtime error stops the program and is recorded in the thread's
+	// ErrorState
+	Value Run(SymbolTable *symbolTable, ExecArena *arena = 0) const {
+		TRACE_SPAN(EVAL, -1);
+		Value result;
+		ErrorState::current().clear();
+		{
+			ExecArena::Scope scope(arena);
+			try {
+				// the profiled path is chosen here, once, rather than per node
+				result = Profiler::active() ? EvalProfiled(symbolTable) : Eval(symbolTable);
+			}
+			catch (RuntimeError& e) {
+				place(e, this->GetLinenum());
+				ErrorState::current().record(e);
+			}
+
+			Rope::Promotion done;
+			for (SymbolTable::iterator it = symbolTable->begin(); it != symbolTable->end(); it++) {
+				it->second.promote(done);
+			}
+			result.promote(done);
+		}
+		return result;
+	}
+
+	virtual Value Eval(SymbolTable *symbolTable) const {
+		runTimeError(this->GetLinenum(), "Invalid ParseTree");
+	}
+
+	// Eval with every node below entered as a frame of the thread's
+	// Profiler. A node without children has nothing more to do
+	virtual Value EvalProfiled(SymbolTable *symbolTable) const {
+		return Eval(symbolTable);
+	}
+
+	// runs this node for every active row of batch at once, leaving one value
+	// per row in result. The rows it fails for are only marked in the batch;
+	// no message is kept, since the caller runs a failed row again on its own
+	virtual void EvalRows(RowBatch& batch, Column& result) const {
+		batch.failActive();
 	}
 
-	virtual Value Eval() {
-		static map<string, Value> symbolTable;
-		return Eval(&symbolTable);
+protected:
+	void EvalChildRows(RowBatch& batch, Column& l, Column& r) const {
+		left->EvalRows(batch, l);
+		right->EvalRows(batch, r);
 	}
 
-	virtual Value Eval(map<string, Value> *symbolTable) const {
-		Value err = Value("Invalid ParseTree", true);
-		runTimeError(this->GetLinenum(), err);
-		return err;
+	// evaluates a child node, on the profiled path if Profiled. An error
+	// raised below that no node has placed yet is placed at this node's line,
+	// and given message instead of its own when one is passed. Nothing is
+	// checked unless an error is thrown
+	template<bool Profiled>
+	Value EvalChild(const ParseTree *child, SymbolTable *symbolTable, const char *message = 0) const {
+		if constexpr (Profiled) {
+			return EvalChildProfiled(child, symbolTable, message);
+		}
+		else {
+			try {
+				return child->Eval(symbolTable);
+			}
+			catch (RuntimeError& e) {
+				place(e, this->GetLinenum(), message);
+				throw;
+			}
+		}
+	}
+
+private:
+	__attribute__((noinline)) Value EvalChildProfiled(const ParseTree *child, SymbolTable *symbolTable,
+			const char *message) const {
+		Profiler::Frame frame(*Profiler::active(), child, child->GetLinenum(), typeid(*child));
+		try {
+			return child->EvalProfiled(symbolTable);
+		}
+		catch (RuntimeError& e) {
+			place(e, this->GetLinenum(), message);
+			throw;
+		}
+	}
+
+	__attribute__((noinline, cold)) static void place(RuntimeError& e, int line, const char *message = 0) {
+		if (!e.hasLine()) {
+			e.line = line;
+			if (message && !e.budget) {
+				e.message = message;
+			}
+		}
 	}
 
 };
 
-class StmtList: public ParseTree {
+// a node with children. Its evaluation is written once, as
+// Evaluate<Profiled>, and instantiated for Eval and for EvalProfiled, so that
+// neither path asks on every node whether it is being profiled
+template<class Node>
+class EvalNode: public ParseTree {
+public:
+	EvalNode(int linenum, ParseTree *l = 0, ParseTree *r = 0) :
+			ParseTree(linenum, l, r) {
+	}
+
+	Value Eval(SymbolTable *symbolTable) const override {
+		return static_cast<const Node *>(this)->template Evaluate<false>(symbolTable);
+	}
+
+	Value EvalProfiled(SymbolTable *symbolTable) const override {
+		return static_cast<const Node *>(this)->template Evaluate<true>(symbolTable);
+	}
+};
+
+class StmtList: public EvalNode<StmtList> {
+	// nodes in the statement at the head, counted once when it is parsed
+	int headNodes;
 
 public:
 	StmtList(ParseTree *l, ParseTree *r) :
-			ParseTree(0, l, r) {
+			EvalNode(0, l, r), headNodes(l ? l->NodeCount() : 0) {
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError((this->GetLinenum()), l);
+	int HeadNodes() const {
+		return headNodes;
+	}
+
+	// runs only the statement at the head of this list, placing an error that
+	// no node below has placed as the whole list would
+	Value EvalHead(SymbolTable *symbolTable) const {
+		Charge();
+		return EvalStatement<false>(left, symbolTable);
+	}
+
+	// the list is right recursive; walk it in a loop instead of recursing
+	// once per statement. An error carries out the number of statements
+	// that completed before it
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		const ParseTree *running = this;
+		try {
+			Charge();
+			Value l = EvalStatement<Profiled>(left, symbolTable);
+			for (running = right; running != 0; running = running->right) {
+				static_cast<const StmtList *>(running)->Charge();
+				EvalStatement<Profiled>(running->left, symbolTable);
+			}
 			return l;
 		}
-		if (right != 0) {
-			Value r = right->Eval(symbolTable);
-			if (r.isError()) {
-				runTimeError(this->GetLinenum(), r);
-				return r;
-			}
+		catch (RuntimeError& e) {
+			e.completed = Completed(running);
+			throw;
 		}
-		return l;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		for (const ParseTree *l = this; l != 0 && batch.anyActive(); l = l->right) {
+			l->left->EvalRows(batch, result);
+		}
+	}
+
+
+private:
+	template<bool Profiled>
+	Value EvalStatement(const ParseTree *statement, SymbolTable *symbolTable) const {
+		TRACE_SPAN(STATEMENT, statement->GetLinenum());
+		return EvalChild<Profiled>(statement, symbolTable);
+	}
+
+	// the statements of this list ahead of running
+	__attribute__((noinline, cold)) size_t Completed(const ParseTree *running) const {
+		size_t n = 0;
+		for (const ParseTree *l = this; l != running; l = l->right) {
+			n++;
+		}
+		return n;
+	}
+
+	// charges the head statement to the execution's budget, if it has one
+	void Charge() const {
+		if (ExecBudget *budget = ExecBudget::active()) {
+			budget->chargeNodes(headNodes, left->GetLinenum());
+		}
+	}
 };
 
-class IfStatement: public ParseTree {
+class IfStatement: public EvalNode<IfStatement> {
 public:
 	IfStatement(int line, ParseTree *ex, ParseTree *stmt) :
-			ParseTree(line, ex, stmt) {
-	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError() || !l.isBoolType()) {
-			Value err = Value("Invalid Boolean Expression inside if", true);
-			runTimeError(this->GetLinenum(), err);
-			return err;
-		}
-		if (l.getBoolean()) {
-			Value r = right->Eval(symbolTable);
-			if (r.isError()) {
-				runTimeError(this->GetLinenum(), r);
-				return r;
-			}
+			EvalNode(line, ex, stmt) {
+	}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable, "Invalid Boolean Expression inside if");
+		if (!l.isBoolType()) {
+			runTimeError(this->GetLinenum(), "Invalid Boolean Expression inside if");
+		}
+		if (l.isTrue()) {
+			EvalChild<Profiled>(right, symbolTable);
 		}
 		return l;
 	}
 
+	// the body runs for the rows whose condition holds
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		left->EvalRows(batch, result);
+		vector<char> outside = batch.active;
+		for (size_t i = 0; i < batch.rows; i++) {
+			if (!batch.active[i]) {
+				continue;
+			}
+			if (result.kind == Column::BOOLS) {
+				batch.active[i] = result.lanes[i] != 0;
+			}
+			else if (result.kind == Column::VALUES && result.values[i].isBoolType()) {
+				batch.active[i] = result.values[i].isTrue();
+			}
+			else {
+				batch.fail(i);
+			}
+		}
+		if (batch.anyActive()) {
+			Column body;
+			right->EvalRows(batch, body);
+		}
+		for (size_t i = 0; i < batch.rows; i++) {
+			batch.active[i] = outside[i] && !batch.failed[i];
+		}
+	}
+
 };
 
-class Assignment: public ParseTree {
+class Assignment: public EvalNode<Assignment> {
 public:
 	Assignment(int line, ParseTree *lhs, ParseTree *rhs) :
-			ParseTree(line, lhs, rhs) {
+			EvalNode(line, lhs, rhs) {
+	}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		if (!left->IsIdent()) {
+			runTimeError(this->GetLinenum(), "Invalid Assignment - Identifier cannot be resolved");
+		}
+		Value r = EvalChild<Profiled>(right, symbolTable);
+		(*symbolTable)[left->GetId()] = r;
+		return r;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		if (left->IsIdent()) {
-			Value r = right->Eval(symbolTable);
-
-			if (r.isError()) {
-				runTimeError(this->GetLinenum(), r);
-				return r;
-			}
-
-			(*symbolTable)[left->GetId()] = r;
-			return r;
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		if (!left->IsIdent()) {
+			batch.failActive();
+			return;
 		}
-		Value err = Value("Invalid Assignment - Identifier cannot be resolved", true);
-		runTimeError(this->GetLinenum(), err);
-		return err;
+		right->EvalRows(batch, result);
+		batch.assign(&left->GetId(), result);
+	}
 
+	void Access(set<const string *>& reads, set<const string *>& writes) const override {
+		if (left->IsIdent()) {
+			writes.insert(&left->GetId());
+		}
+		right->Access(reads, writes);
 	}
 };
 
-class PrintStatement: public ParseTree {
+class PrintStatement: public EvalNode<PrintStatement> {
 public:
 	PrintStatement(int line, ParseTree *e) :
-			ParseTree(line, e) {
+			EvalNode(line, e) {
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			Value err = Value("Invalid print", true);
-			runTimeError(this->GetLinenum(), err);
-			return err;
-		}
-		else {
-			cout << l << endl;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable, "Invalid print");
+		TRACE_EVENT(PRINT, this->GetLinenum());
+		*OutputSink::active() << l << '\n';
 		return l;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		left->EvalRows(batch, result);
+		OutputSink line;
+		for (size_t i = 0; i < batch.rows; i++) {
+			if (batch.active[i]) {
+				line << result.at(i) << '\n';
+				batch.output[i] += line.take();
+			}
+		}
+	}
+
 };
 
-class PlusExpr: public ParseTree {
+class PlusExpr: public EvalNode<PlusExpr> {
 public:
 	PlusExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l + r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.arith('+', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a + b;
+			});
+		}
+	}
+
 };
 
-class MinusExpr: public ParseTree {
+class MinusExpr: public EvalNode<MinusExpr> {
 public:
 	MinusExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l - r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.arith('-', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a - b;
+			});
+		}
+	}
+
 };
 
-class TimesExpr: public ParseTree {
+class TimesExpr: public EvalNode<TimesExpr> {
 public:
 	TimesExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l * r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.arith('*', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a * b;
+			});
+		}
+	}
+
 };
 
-class DivideExpr: public ParseTree {
+class DivideExpr: public EvalNode<DivideExpr> {
 public:
 	DivideExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
+		return l / r;
+	}
 
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.arith('/', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a / b;
+			});
 		}
-		return l / r;
 	}
 
 };
 
-class LogicAndExpr: public ParseTree {
+class LogicAndExpr: public EvalNode<LogicAndExpr> {
 public:
 	LogicAndExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l && r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.logic('&', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a && b;
+			});
+		}
+	}
+
 };
 
-class LogicOrExpr: public ParseTree {
+class LogicOrExpr: public EvalNode<LogicOrExpr> {
 public:
 	LogicOrExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l || r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.logic('|', l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a || b;
+			});
+		}
+	}
+
 };
 
-class EqExpr: public ParseTree {
+class EqExpr: public EvalNode<EqExpr> {
 public:
 	EqExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l == r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::EQ, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a == b;
+			});
+		}
+	}
+
 };
 
-class NEqExpr: public ParseTree {
+class NEqExpr: public EvalNode<NEqExpr> {
 public:
 	NEqExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l != r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::NE, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a != b;
+			});
+		}
+	}
+
 };
 
-class LtExpr: public ParseTree {
+class LtExpr: public EvalNode<LtExpr> {
 public:
 	LtExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l < r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::LT, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a < b;
+			});
+		}
+	}
+
 };
 
-class LEqExpr: public ParseTree {
+class LEqExpr: public EvalNode<LEqExpr> {
 public:
 	LEqExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l <= r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::LE, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a <= b;
+			});
+		}
+	}
+
 };
 
-class GtExpr: public ParseTree {
+class GtExpr: public EvalNode<GtExpr> {
 public:
 	GtExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l > r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::GT, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a > b;
+			});
+		}
+	}
+
 };
 
-class GEqExpr: public ParseTree {
+class GEqExpr: public EvalNode<GEqExpr> {
 public:
 	GEqExpr(int line, ParseTree *l, ParseTree *r) :
-			ParseTree(line, l, r) {
+			EvalNode(line, l, r) {
 	}
 
 	NodeType GetType() const {
 		return BOOLTYPE;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
-		Value l = left->Eval(symbolTable);
-		if (l.isError()) {
-			runTimeError(this->GetLinenum(), l);
-			return l;
-		}
-		Value r = right->Eval(symbolTable);
-		if (r.isError()) {
-			runTimeError(this->GetLinenum(), r);
-			return r;
-		}
+	template<bool Profiled>
+	Value Evaluate(SymbolTable *symbolTable) const {
+		Value l = EvalChild<Profiled>(left, symbolTable);
+		Value r = EvalChild<Profiled>(right, symbolTable);
 		return l >= r;
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		Column l, r;
+		EvalChildRows(batch, l, r);
+		if (!batch.compare(ColumnKernels::GE, l, r, result)) {
+			batch.combine(l, r, result, [](Value& a, const Value& b) {
+				return a >= b;
+			});
+		}
+	}
+
 };
 
 class IConst: public ParseTree {
-	int val;
+	Value val;
 
 public:
 	IConst(int l, int i) :
 			ParseTree(l), val(i) {
 	}
+	// constants too large for 64 bits become BigInts instead of failing
 	IConst(Token& t) :
-			ParseTree(t.GetLinenum()) {
-		val = stoi(t.GetLexeme());
+			ParseTree(t.GetLinenum()), val(BigInt::fromString(t.GetLexeme())) {
 	}
 
 	NodeType GetType() const {
@@ -488,9 +753,13 @@ public:
 	bool IsInt() const {
 		return true;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
+	Value Eval(SymbolTable *symbolTable) const override {
 		//cout << "Iconst: " << val << endl;
-		return Value(val);
+		return val;
+	}
+
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		result.fill(val, batch.rows);
 	}
 
 };
@@ -510,20 +779,23 @@ public:
 	bool IsBool() const {
 		return true;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
+	Value Eval(SymbolTable *symbolTable) const override {
 		//cout << "Bool " << val << endl;
 		return Value(val);
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		result.fill(Value(val), batch.rows);
+	}
+
 };
 
 class SConst: public ParseTree {
-	string val;
+	Rope val;
 
 public:
 	SConst(Token& t) :
-			ParseTree(t.GetLinenum()) {
-		val = t.GetLexeme();
+			ParseTree(t.GetLinenum()), val(InternTable::instance().constant(t.GetLexeme())) {
 	}
 
 	NodeType GetType() const {
@@ -532,33 +804,59 @@ public:
 	bool IsString() const {
 		return true;
 	}
-	Value Eval(map<string, Value> *symbolTable) const override {
+	Value Eval(SymbolTable *symbolTable) const override {
 		//cout << "Sconst: " << val << endl;
 		return Value(val);
 	}
 
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		result.fill(Value(val), batch.rows);
+	}
+
 };
 
 class Ident: public ParseTree {
-	string id;
+	const string& id;
 
 public:
 	Ident(Token& t) :
-			ParseTree(t.GetLinenum()), id(t.GetLexeme()) {
+			ParseTree(t.GetLinenum()), id(InternTable::instance().name(t.GetLexeme())) {
 	}
 
 	bool IsIdent() const {
 		return true;
 	}
-	string GetId() const {
+	const string& GetId() const {
 		return id;
 	}
 
-	Value Eval(map<string, Value> *symbolTable) const override {
-		if (symbolTable->find(id) == symbolTable->end()) {
-			return Value("Identifier not found", true);
+	Value Eval(SymbolTable *symbolTable) const override {
+		SymbolTable::const_iterator it = symbolTable->find(id);
+		// a table may hold empty entries for names not yet assigned
+		if (it == symbolTable->end() || !it->second.hasValue()) {
+			runTimeError("Identifier not found");
+		}
+		return it->second;
+	}
+
+	void EvalRows(RowBatch& batch, Column& result) const override {
+		map<const string *, Column>::const_iterator it = batch.variables.find(&id);
+		if (it == batch.variables.end()) {
+			batch.failActive();
+			return;
+		}
+		result = it->second;
+		if (result.kind == Column::VALUES) {
+			for (size_t i = 0; i < batch.rows; i++) {
+				if (batch.active[i] && !result.values[i].hasValue()) {
+					batch.fail(i);
+				}
+			}
 		}
-		return (*symbolTable)[id];
+	}
+
+	void Access(set<const string *>& reads, set<const string *>& writes) const override {
+		reads.insert(&id);
 	}
 
 };
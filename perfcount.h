@@ -0,0 +1,137 @@
+/*
+ * perfcount.h
+ */
+
+#ifndef PERFCOUNT_H_
+#define PERFCOUNT_H_
+
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+using namespace std;
+
+// hardware counters for this thread through perf_event_open, for --perf.
+// Each event is opened on its own, counting user space only, so that a
+// machine or container that allows some events and not others still gets
+// those it allows; an event that cannot be opened reads as unavailable.
+// The counters run from construction, and a phase is the difference of two
+// readings, scaled up when the kernel had to share the hardware
+class PerfCounters {
+public:
+	enum Event {
+		CYCLES, INSTRUCTIONS, BRANCH_MISSES, CACHE_MISSES, TASK_CLOCK, EVENTS
+	};
+
+	static const long long UNAVAILABLE = -1;
+
+	struct Sample {
+		long long value[EVENTS];
+
+		Sample() {
+			for (int e = 0; e < EVENTS; e++) {
+				value[e] = UNAVAILABLE;
+			}
+		}
+
+		bool has(Event e) const {
+			return value[e] != UNAVAILABLE;
+		}
+	};
+
+private:
+	int fd[EVENTS];
+	Sample begun;
+	// why the first event that failed could not be opened
+	string problem;
+
+public:
+	PerfCounters() {
+		for (int e = 0; e < EVENTS; e++) {
+			fd[e] = open(Event(e));
+			if (fd[e] < 0 && problem.empty()) {
+				problem = string(name(Event(e))) + ": " + strerror(errno);
+			}
+		}
+	}
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	~PerfCounters() {
+		for (int e = 0; e < EVENTS; e++) {
+			if (fd[e] >= 0) {
+				close(fd[e]);
+			}
+		}
+	}
+
+	// empty if every event could be opened
+	const string& getProblem() const {
+		return problem;
+	}
+
+	void start() {
+		begun = read();
+	}
+
+	// the counts since start()
+	Sample stop() const {
+		Sample now = read();
+		for (int e = 0; e < EVENTS; e++) {
+			if (now.has(Event(e)) && begun.has(Event(e))) {
+				now.value[e] -= begun.value[e];
+			}
+			else {
+				now.value[e] = UNAVAILABLE;
+			}
+		}
+		return now;
+	}
+
+	static const char *name(Event e) {
+		static const char *names[EVENTS] = { "cycles", "instructions", "branch_misses", "cache_misses",
+				"task_clock_ns" };
+		return names[e];
+	}
+
+private:
+	Sample read() const {
+		Sample s;
+		for (int e = 0; e < EVENTS; e++) {
+			// value, time enabled, time running
+			uint64_t counts[3];
+			if (fd[e] >= 0 && ::read(fd[e], counts, sizeof counts) == sizeof counts && counts[2] > 0) {
+				s.value[e] = counts[2] < counts[1] ? (long long) ((double) counts[0] * counts[1] / counts[2]) : counts[0];
+			}
+		}
+		return s;
+	}
+
+	static int open(Event e) {
+#ifdef __linux__
+		static const uint32_t types[EVENTS] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+				PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE };
+		static const uint64_t configs[EVENTS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+				PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_TASK_CLOCK };
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.type = types[e];
+		attr.config = configs[e];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+#else
+		errno = ENOSYS;
+		return -1;
+#endif
+	}
+};
+
+#endif /* PERFCOUNT_H_ */
@@ -0,0 +1,254 @@
+/*
+ * profile.h
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <typeinfo>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+#include <cxxabi.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+using namespace std;
+
+// counts the evaluations of the lines of a program and the time spent on
+// them, for --profile. A run with a profiler active on the thread takes the
+// EvalProfiled path, where every node but the root is evaluated through its
+// parent's EvalChild, which enters a frame here.
+//
+// Only a node on another line than the frame above it, the outermost node
+// of a line, gets a frame of its own; the nodes below it on the same line
+// are counted in it. So there is about one frame per statement rather than
+// one per node, which is all the per line report needs, and the collapsed
+// stacks end at the outermost node of each line. A node has one parent, so
+// its frame always sits under the same one, and the frames form a tree the
+// shape of the program. Time is read from the cycle counter where there is
+// one and turned into nanoseconds against the steady clock over the whole
+// profile.
+//
+// The clock is read twice per frame. A profiled run takes about 1.2 to 1.3
+// times as long as a plain one on statements of a dozen nodes or so, and
+// about twice as long on the shortest statements, where the clock reads
+// cost as much as the statement
+class Profiler {
+	static const uint32_t NONE = uint32_t(-1);
+
+	struct Record {
+		const type_info *type;
+		int line;
+		uint32_t parent;
+		uint64_t hits;
+		uint64_t ticks;
+		uint64_t childTicks;
+		uint64_t stringBytes;
+		// the first two children entered, found without a lookup
+		const void *kid[2];
+		uint32_t kidRecord[2];
+	};
+
+	// the root, record 0, stands for the program
+	vector<Record> records;
+	// records past the first two children of their parent
+	unordered_map<const void *, uint32_t> others;
+
+	// an entered frame: its record and when it was entered
+	struct Open {
+		uint32_t record;
+		uint64_t start;
+	};
+	vector<Open> stack;
+	chrono::steady_clock::time_point clockStart;
+	uint64_t tickStart;
+
+public:
+	// room for nodes records up front, so that a first run does not keep
+	// growing the table
+	Profiler(size_t nodes = 0) :
+			clockStart(chrono::steady_clock::now()), tickStart(ticks()) {
+		records.reserve(nodes + 1);
+		records.push_back(Record { 0, -1, NONE, 1, 0, 0, 0, { 0, 0 }, { NONE, NONE } });
+		stack.push_back(Open { 0, tickStart });
+	}
+
+	// the profiler evaluations on this thread are counted in, if any
+	static Profiler *&active() {
+		static thread_local Profiler *profiler = nullptr;
+		return profiler;
+	}
+
+	class Scope {
+		Profiler *previous;
+
+	public:
+		Scope(Profiler *profiler) :
+				previous(active()) {
+			active() = profiler;
+		}
+		~Scope() {
+			active() = previous;
+		}
+	};
+
+	// a node's evaluation, from construction to destruction, so that a frame
+	// left by a runtime error is closed too. A node on the line of the frame
+	// above it enters none
+	class Frame {
+		Profiler& profiler;
+		bool entered;
+
+	public:
+		Frame(Profiler& profiler, const void *node, int line, const type_info& type) :
+				profiler(profiler), entered(profiler.enter(node, line, type)) {
+		}
+		~Frame() {
+			if (entered) {
+				profiler.leave();
+			}
+		}
+	};
+
+	// strings of bytes made by the line being evaluated
+	void chargeString(size_t bytes) {
+		records[stack.back().record].stringBytes += bytes;
+	}
+
+	// for each line, the hits and total time of the outermost nodes on it,
+	// and the time and string bytes of every node on it that are not counted
+	// on a child
+	void writeReport(ostream& out) const {
+		struct Line {
+			uint64_t hits, ticks, selfTicks, stringBytes;
+		};
+		map<int, Line> lines;
+		for (size_t i = 1; i < records.size(); i++) {
+			const Record& r = records[i];
+			Line& l = lines[r.line];
+			if (r.parent == 0 || records[r.parent].line != r.line) {
+				l.hits += r.hits;
+				l.ticks += r.ticks;
+			}
+			l.selfTicks += selfTicks(r);
+			l.stringBytes += r.stringBytes;
+		}
+		double scale = nanosPerTick() / 1000;
+		out << "line\thits\ttotal_us\tself_us\tstring_bytes\n";
+		for (const pair<const int, Line>& l : lines) {
+			out << l.first << '\t' << l.second.hits << '\t' << l.second.ticks * scale << '\t'
+					<< l.second.selfTicks * scale << '\t' << l.second.stringBytes << '\n';
+		}
+	}
+
+	// one line per node, "program;Assignment:3;PlusExpr:3 <self nanoseconds>",
+	// as flamegraph.pl and most other flame graph tools read
+	void writeCollapsed(ostream& out) const {
+		double scale = nanosPerTick();
+		map<const type_info *, string> names;
+		vector<string> paths(records.size());
+		paths[0] = "program";
+		for (size_t i = 1; i < records.size(); i++) {
+			const Record& r = records[i];
+			string& name = names[r.type];
+			if (name.empty()) {
+				name = demangle(*r.type);
+			}
+			// a parent is always entered, and recorded, before its children
+			paths[i] = paths[r.parent] + ';' + name + ':' + to_string(r.line);
+			uint64_t self = (uint64_t) (selfTicks(r) * scale);
+			if (self > 0) {
+				out << paths[i] << ' ' << self << '\n';
+			}
+		}
+	}
+
+private:
+	bool enter(const void *node, int line, const type_info& type) {
+		uint32_t parent = stack.back().record;
+		Record& p = records[parent];
+		if (line == p.line) {
+			return false;
+		}
+		uint32_t index;
+		if (p.kid[0] == node) {
+			index = p.kidRecord[0];
+		}
+		else if (p.kid[1] == node) {
+			index = p.kidRecord[1];
+		}
+		else {
+			index = find(node, line, type, parent);
+		}
+		records[index].hits++;
+		stack.push_back(Open { index, ticks() });
+		return true;
+	}
+
+	void leave() {
+		Open frame = stack.back();
+		stack.pop_back();
+		uint64_t spent = ticks() - frame.start;
+		records[frame.record].ticks += spent;
+		records[stack.back().record].childTicks += spent;
+	}
+
+	__attribute__((noinline)) uint32_t find(const void *node, int line, const type_info& type, uint32_t parent) {
+		// a parent only uses the table once both its slots are taken
+		if (records[parent].kid[1] != 0) {
+			unordered_map<const void *, uint32_t>::iterator it = others.find(node);
+			if (it != others.end()) {
+				return it->second;
+			}
+		}
+		uint32_t index = records.size();
+		records.push_back(Record { &type, line, parent, 0, 0, 0, 0, { 0, 0 }, { NONE, NONE } });
+		Record& p = records[parent];
+		if (p.kid[0] == 0) {
+			p.kid[0] = node;
+			p.kidRecord[0] = index;
+		}
+		else if (p.kid[1] == 0) {
+			p.kid[1] = node;
+			p.kidRecord[1] = index;
+		}
+		else {
+			others[node] = index;
+		}
+		return index;
+	}
+
+	static uint64_t selfTicks(const Record& r) {
+		return r.ticks > r.childTicks ? r.ticks - r.childTicks : 0;
+	}
+
+	double nanosPerTick() const {
+		double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - clockStart).count();
+		uint64_t elapsed = ticks() - tickStart;
+		return elapsed ? nanos / elapsed : 0;
+	}
+
+	static uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static string demangle(const type_info& type) {
+		int status;
+		char *name = abi::__cxa_demangle(type.name(), 0, 0, &status);
+		string s = status == 0 ? name : type.name();
+		free(name);
+		return s;
+	}
+};
+
+#endif /* PROFILE_H_ */
@@ -0,0 +1,131 @@
+/*
+ * progcache.h
+ */
+
+#ifndef PROGCACHE_H_
+#define PROGCACHE_H_
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include "parse.h"
+using namespace std;
+
+// compiled programs by source text, for a service that is sent the same
+// scripts over and over: a repeat skips the lexer and parser entirely. The
+// programs are shared and never change, so any number of threads may run
+// one at once, and one evicted while it runs lives until the run ends.
+//
+// The cache holds at most maxBytes, by an estimate of the source and the
+// parse tree of each program, and evicts the least recently used first.
+// Sources that do not parse are not kept, so their errors are reported on
+// every submission
+class ProgramCache {
+public:
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		size_t entries;
+		size_t bytes;
+	};
+
+private:
+	struct Entry {
+		string source;
+		shared_ptr<const ParseTree> prog;
+		size_t bytes;
+	};
+
+	size_t maxBytes;
+	mutable mutex lock;
+	// most recently used first
+	list<Entry> entries;
+	// keys point into the entries' sources
+	unordered_map<string_view, list<Entry>::iterator> index;
+	Stats counts;
+
+public:
+	ProgramCache(size_t maxBytes) :
+			maxBytes(maxBytes), counts() {
+	}
+	ProgramCache(const ProgramCache&) = delete;
+	ProgramCache& operator=(const ProgramCache&) = delete;
+
+	// the program for source, parsed on a miss; 0 if it does not parse, after
+	// the errors have been reported as Prog reports them
+	shared_ptr<const ParseTree> get(const string& source) {
+		{
+			lock_guard<mutex> guard(lock);
+			unordered_map<string_view, list<Entry>::iterator>::iterator it = index.find(source);
+			if (it != index.end()) {
+				counts.hits++;
+				entries.splice(entries.begin(), entries, it->second);
+				return it->second->prog;
+			}
+			counts.misses++;
+		}
+
+		// parsed unlocked; a thread that misses on the same source meanwhile
+		// parses it too, and the first to finish is kept
+		istringstream in(source);
+		int line = 0;
+		shared_ptr<const ParseTree> prog(Prog(&in, &line));
+		if (!prog) {
+			return prog;
+		}
+		size_t bytes = estimate(source, *prog);
+
+		lock_guard<mutex> guard(lock);
+		unordered_map<string_view, list<Entry>::iterator>::iterator it = index.find(source);
+		if (it != index.end()) {
+			entries.splice(entries.begin(), entries, it->second);
+			return it->second->prog;
+		}
+		if (bytes > maxBytes) {
+			return prog;
+		}
+		while (counts.bytes + bytes > maxBytes) {
+			evictOldest();
+		}
+		entries.push_front(Entry { source, prog, bytes });
+		index[entries.front().source] = entries.begin();
+		counts.bytes += bytes;
+		counts.entries++;
+		return prog;
+	}
+
+	Stats stats() const {
+		lock_guard<mutex> guard(lock);
+		return counts;
+	}
+
+	void clear() {
+		lock_guard<mutex> guard(lock);
+		while (!entries.empty()) {
+			evictOldest();
+		}
+	}
+
+private:
+	void evictOldest() {
+		Entry& e = entries.back();
+		index.erase(e.source);
+		counts.bytes -= e.bytes;
+		counts.entries--;
+		counts.evictions++;
+		entries.pop_back();
+	}
+
+	// the source, as much again for the string constants taken from it, and
+	// every node at the size of the largest with the allocator's overhead
+	static size_t estimate(const string& source, const ParseTree& prog) {
+		return sizeof(Entry) + 2 * source.size() + prog.NodeCount() * (sizeof(IConst) + 16);
+	}
+};
+
+#endif /* PROGCACHE_H_ */
@@ -0,0 +1,235 @@
+/*
+ * reactive.h
+ */
+
+#ifndef REACTIVE_H_
+#define REACTIVE_H_
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include "parse.h"
+using namespace std;
+
+// keeps a program's results up to date as its inputs change, the way a
+// spreadsheet does. Inputs are the values names have before the program
+// starts. Every top level statement records the value each name it assigns
+// has after it, and the statement each name it reads or assigns last comes
+// from, so a statement can be run again on its own against exactly what it
+// saw in a complete run. Changing an input runs again only the statements
+// that depend on it, in program order, and goes on to the statements that
+// depend on those only where an assigned value actually changed.
+//
+// A runtime error ends the program as usual. While the program stands at an
+// error every update runs it again from the start, since the statements past
+// the error have no results to reuse
+class ReactiveProgram {
+	static const size_t NONE = size_t(-1);
+
+	struct Statement {
+		const StmtList *link;
+		// each name the statement reads or assigns, with the statement that
+		// assigned it last before this one, or NONE for the input
+		vector<pair<const string *, size_t>> sources;
+		// the names assigned, and their values once the statement has run;
+		// an empty Value for a name still unset afterwards
+		map<const string *, Value> after;
+		// for each name assigned, the statements that take it from this one
+		map<const string *, vector<size_t>> dependents;
+		string out;
+		string err;
+	};
+
+	vector<Statement> statements;
+	SymbolTable inputs;
+	// statements that take each name from the inputs
+	map<const string *, vector<size_t>> inputDependents;
+	set<size_t> dirty;
+	// first statement that failed, or NONE
+	size_t failure;
+
+public:
+	ReactiveProgram(ParseTree *prog) :
+			failure(NONE) {
+		for (ParseTree *l = prog; l != 0; l = l->right) {
+			statements.push_back(Statement());
+			statements.back().link = static_cast<const StmtList *>(l);
+		}
+		analyze();
+	}
+
+	const SymbolTable& getInputs() const {
+		return inputs;
+	}
+
+	// changes an input; nothing runs until recompute(). An empty Value unsets it
+	void setInput(const string& name, const Value& v) {
+		SymbolTable::iterator it = inputs.find(name);
+		Value old = it == inputs.end() ? Value() : it->second;
+		if (old.sameAs(v)) {
+			return;
+		}
+		if (v.hasValue()) {
+			inputs[name] = v;
+		}
+		else {
+			inputs.erase(name);
+		}
+		map<const string *, vector<size_t>>::iterator d = inputDependents.find(&InternTable::instance().name(name));
+		if (d != inputDependents.end()) {
+			dirty.insert(d->second.begin(), d->second.end());
+		}
+		if (failure != NONE) {
+			dirty.insert(0);
+		}
+	}
+
+	// runs every statement and writes all the output, as an ordinary run would
+	void run(OutputSink& out, OutputSink& err) {
+		runAll();
+		dirty.clear();
+		show(out, err);
+	}
+
+	// writes the output an ordinary run with the current inputs would give
+	void show(OutputSink& out, OutputSink& err) const {
+		for (size_t i = 0; i < statements.size() && i <= failure; i++) {
+			out << statements[i].out;
+		}
+		if (failure != NONE) {
+			out.flush();
+			err << statements[failure].err;
+			err.flush();
+		}
+	}
+
+	// runs the statements the changed inputs reach and writes the output of
+	// each one that printed, prefixed with its line. Returns how many
+	// statements ran
+	size_t recompute(OutputSink& out, OutputSink& err) {
+		if (dirty.empty()) {
+			return 0;
+		}
+		vector<size_t> ran;
+		if (failure == NONE) {
+			while (!dirty.empty()) {
+				size_t i = *dirty.begin();
+				dirty.erase(dirty.begin());
+				if (!runOne(i)) {
+					break;
+				}
+				ran.push_back(i);
+			}
+		}
+		if (failure != NONE) {
+			ran.clear();
+			runAll();
+			for (size_t i = 0; i < statements.size() && i <= failure; i++) {
+				ran.push_back(i);
+			}
+		}
+		dirty.clear();
+
+		for (size_t i : ran) {
+			const Statement& s = statements[i];
+			if (!s.out.empty()) {
+				out << s.link->left->GetLinenum() << ": " << s.out;
+			}
+		}
+		if (failure != NONE) {
+			out.flush();
+			err << statements[failure].err;
+			err.flush();
+		}
+		out.flush();
+		return ran.size();
+	}
+
+private:
+	void analyze() {
+		map<const string *, size_t> lastWrite;
+		for (size_t i = 0; i < statements.size(); i++) {
+			Statement& s = statements[i];
+			set<const string *> reads, writes;
+			s.link->left->Access(reads, writes);
+			reads.insert(writes.begin(), writes.end());
+			for (const string *id : reads) {
+				map<const string *, size_t>::iterator w = lastWrite.find(id);
+				size_t from = w == lastWrite.end() ? NONE : w->second;
+				s.sources.push_back(make_pair(id, from));
+				(from == NONE ? inputDependents : statements[from].dependents)[id].push_back(i);
+			}
+			for (const string *id : writes) {
+				s.after[id] = Value();
+				lastWrite[id] = i;
+			}
+		}
+	}
+
+	void runAll() {
+		failure = NONE;
+		for (size_t i = 0; i < statements.size(); i++) {
+			statements[i].out.clear();
+			statements[i].err.clear();
+		}
+		for (size_t i = 0; i < statements.size() && runOne(i); i++) {
+		}
+	}
+
+	// runs statement i against the values it depends on and marks the
+	// statements that depend on an assignment that changed. Returns false if
+	// it failed
+	bool runOne(size_t i) {
+		Statement& s = statements[i];
+		SymbolTable table;
+		for (const pair<const string *, size_t>& source : s.sources) {
+			const Value *v;
+			if (source.second == NONE) {
+				SymbolTable::const_iterator it = inputs.find(*source.first);
+				v = it == inputs.end() ? 0 : &it->second;
+			}
+			else {
+				v = &statements[source.second].after[source.first];
+			}
+			if (v != 0 && v->hasValue()) {
+				table[*source.first] = *v;
+			}
+		}
+
+		OutputSink out, err;
+		OutputSink *previousOut = OutputSink::active();
+		OutputSink *previousErr = OutputSink::activeError();
+		OutputSink::active() = &out;
+		OutputSink::activeError() = &err;
+		ErrorState& state = ErrorState::current();
+		state.clear();
+		try {
+			s.link->EvalHead(&table);
+		}
+		catch (RuntimeError& e) {
+			state.record(e);
+		}
+		OutputSink::active() = previousOut;
+		OutputSink::activeError() = previousErr;
+		s.out = out.take();
+		s.err = err.take();
+		if (state.hasFailed()) {
+			failure = i;
+			return false;
+		}
+
+		for (map<const string *, Value>::iterator it = s.after.begin(); it != s.after.end(); it++) {
+			SymbolTable::iterator v = table.find(*it->first);
+			Value now = v == table.end() ? Value() : v->second;
+			if (!now.sameAs(it->second)) {
+				it->second = now;
+				vector<size_t>& dependents = s.dependents[it->first];
+				dirty.insert(dependents.begin(), dependents.end());
+			}
+		}
+		return true;
+	}
+};
+
+#endif /* REACTIVE_H_ */
@@ -0,0 +1,425 @@
+/*
+ * rope.h
+ */
+
+#ifndef ROPE_H_
+#define ROPE_H_
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <atomic>
+#include "arena.h"
+#include "memory.h"
+#include "strkernels.h"
+using namespace std;
+
+// heap allocations made for runtime rope nodes and their characters on this
+// thread; nodes built in an ExecArena and interned constants are not counted
+struct RopeStats {
+	static inline thread_local size_t heapNodes = 0;
+	static inline thread_local size_t heapTextAllocations = 0;
+	static inline thread_local size_t heapTextBytes = 0;
+	static inline thread_local size_t promoted = 0;
+};
+
+// a node of an immutable rope. A leaf holds characters, a concat joins two
+// ropes and a repeat stands for its child written count times. Concat nodes
+// are kept height balanced so that appending to a long rope stays O(log n)
+struct RopeNode {
+	enum Kind {
+		LEAF, CONCAT, REPEAT
+	};
+
+	Kind kind;
+	size_t length;
+	int height;
+	shared_ptr<const RopeNode> left;
+	shared_ptr<const RopeNode> right;
+	size_t count;
+
+	// set on the single canonical leaf kept by the intern table
+	bool interned;
+
+	// the arena this node and its characters were allocated from, or null
+	ExecArena *arena;
+	// true if this node or anything below it lives in an arena
+	bool arenaBacked;
+
+	// a leaf's characters; concat and repeat nodes set this to their
+	// flattened text once it is asked for. Threads that read a shared value
+	// may flatten the same node at once, so the text is published with a
+	// compare and swap and the losing copy is thrown away
+	mutable atomic<const char *> text;
+	// storage behind a leaf's text when the node is not in an arena
+	mutable string owned;
+	// storage behind flattened text that did not go into an arena
+	mutable unique_ptr<char[]> flat;
+
+	// a leaf holding a followed by b
+	RopeNode(ExecArena *arena, string_view a, string_view b) :
+			kind(LEAF), length(a.size() + b.size()), height(0), count(1), interned(false), arena(arena), arenaBacked(
+					arena != nullptr), text(nullptr) {
+		char *buf = buffer(length);
+		memcpy(buf, a.data(), a.size());
+		memcpy(buf + a.size(), b.data(), b.size());
+		text.store(buf, memory_order_relaxed);
+	}
+	// a leaf holding piece written copies times
+	RopeNode(ExecArena *arena, string_view piece, size_t copies) :
+			kind(LEAF), length(piece.size() * copies), height(0), count(1), interned(false), arena(arena), arenaBacked(
+					arena != nullptr), text(nullptr) {
+		char *buf = buffer(length);
+		StrKernels::repeat(buf, piece.data(), piece.size(), copies);
+		text.store(buf, memory_order_relaxed);
+	}
+	RopeNode(ExecArena *arena, string s) :
+			kind(LEAF), length(s.size()), height(0), count(1), interned(false), arena(arena), arenaBacked(
+					arena != nullptr), text(nullptr) {
+		if (arena) {
+			char *buf = buffer(length);
+			memcpy(buf, s.data(), length);
+			text.store(buf, memory_order_relaxed);
+		}
+		else {
+			countHeapText(length);
+			owned = std::move(s);
+			countOwned();
+			text.store(owned.data(), memory_order_relaxed);
+		}
+	}
+	RopeNode(ExecArena *arena, shared_ptr<const RopeNode> l, shared_ptr<const RopeNode> r) :
+			kind(CONCAT), length(l->length + r->length), height(max(l->height, r->height) + 1), left(l), right(r), count(
+					1), interned(false), arena(arena), arenaBacked(arena || l->arenaBacked || r->arenaBacked), text(
+					nullptr) {
+	}
+	RopeNode(ExecArena *arena, shared_ptr<const RopeNode> child, size_t count) :
+			kind(REPEAT), length(child->length * count), height(0), left(child), count(count), interned(false), arena(
+					arena), arenaBacked(arena || child->arenaBacked), text(nullptr) {
+	}
+	~RopeNode() {
+		if (owned.capacity() > string().capacity()) {
+			MemoryStats::removeString(owned.capacity());
+		}
+		if (flat) {
+			MemoryStats::removeString(length);
+		}
+	}
+
+	// copies the characters into out, which has room for length bytes
+	void fill(char *out) const {
+		if (const char *t = text.load(memory_order_acquire)) {
+			memcpy(out, t, length);
+		}
+		else if (kind == CONCAT) {
+			left->fill(out);
+			right->fill(out + left->length);
+		}
+		else {
+			// lay the child down once, then double it in place
+			left->fill(out);
+			StrKernels::repeat(out, out, left->length, count);
+		}
+	}
+
+	string_view view() const {
+		const char *t = text.load(memory_order_acquire);
+		return string_view(t ? t : flatten(), length);
+	}
+
+	// out is an ostream or anything else with write(const char *, size_t)
+	template<class Out>
+	void writeTo(Out& out) const {
+		if (const char *t = text.load(memory_order_acquire)) {
+			out.write(t, length);
+		}
+		else if (kind == CONCAT) {
+			left->writeTo(out);
+			right->writeTo(out);
+		}
+		else {
+			for (size_t i = 0; i < count; i++) {
+				left->writeTo(out);
+			}
+		}
+	}
+
+private:
+	static void countHeapText(size_t n) {
+		if (n > string().capacity()) {
+			RopeStats::heapTextAllocations++;
+			RopeStats::heapTextBytes += n;
+		}
+	}
+
+	const char *flatten() const {
+		// another thread's arena cannot be allocated from, or outlive its reset
+		bool inArena = arena && arena == ExecArena::active() && !arena->full();
+		char *buf;
+		if (inArena) {
+			buf = static_cast<char *>(arena->allocate(length, 1));
+		}
+		else {
+			countHeapText(length);
+			buf = new char[length];
+		}
+		fill(buf);
+		const char *expected = nullptr;
+		if (text.compare_exchange_strong(expected, buf, memory_order_acq_rel)) {
+			if (!inArena) {
+				flat.reset(buf);
+				MemoryStats::addString(length);
+			}
+			return buf;
+		}
+		if (!inArena) {
+			delete[] buf;
+		}
+		return expected;
+	}
+
+	char *buffer(size_t n) const {
+		if (arena && !arena->full()) {
+			return static_cast<char *>(arena->allocate(n, 1));
+		}
+		countHeapText(n);
+		owned.resize(n);
+		countOwned();
+		return &owned[0];
+	}
+
+	// counts owned's characters in MemoryStats once they are on the heap
+	void countOwned() const {
+		if (owned.capacity() > string().capacity()) {
+			MemoryStats::addString(owned.capacity());
+		}
+	}
+};
+
+// string payload of a Value. Nodes are immutable and reference counted, so
+// copying a Rope (reading a variable, returning a Value) is O(1) and never
+// touches the characters; concatenation and repetition build new nodes
+// sharing the operands. The text is only flattened when it is printed or
+// compared. The empty string has no node at all, so int and bool Values
+// carry no allocation.
+//
+// While an ExecArena is active on the thread, new nodes and their characters
+// are placed in it; promote() copies a rope that has to outlive the
+// execution back onto the heap
+class Rope {
+	typedef shared_ptr<const RopeNode> Ref;
+
+	// leaves shorter than this are merged on concatenation, so that appending
+	// one character at a time does not build one node per character
+	static const size_t SMALL = 512;
+
+	Ref node;
+
+	explicit Rope(Ref node) :
+			node(node) {
+	}
+
+	template<class ... Args>
+	static Ref make(ExecArena *arena, Args&&... args) {
+		if (arena && !arena->full()) {
+			return allocate_shared<const RopeNode>(ArenaAllocator<RopeNode>(arena), arena, std::forward<Args>(args)...);
+		}
+		RopeStats::heapNodes++;
+		return allocate_shared<const RopeNode>(CountingAllocator<RopeNode, StringAccount>(), nullptr,
+				std::forward<Args>(args)...);
+	}
+
+	static Ref leaf(string_view a, string_view b = string_view()) {
+		return make(ExecArena::active(), a, b);
+	}
+
+	static Ref concat(const Ref& l, const Ref& r) {
+		return make(ExecArena::active(), l, r);
+	}
+
+	// joins two balanced ropes whose heights differ by at most two
+	static Ref balance(const Ref& l, const Ref& r) {
+		if (l->height > r->height + 1) {
+			if (l->left->height >= l->right->height) {
+				return concat(l->left, concat(l->right, r));
+			}
+			const Ref& lr = l->right;
+			return concat(concat(l->left, lr->left), concat(lr->right, r));
+		}
+		if (r->height > l->height + 1) {
+			if (r->right->height >= r->left->height) {
+				return concat(concat(l, r->left), r->right);
+			}
+			const Ref& rl = r->left;
+			return concat(concat(l, rl->left), concat(rl->right, r->right));
+		}
+		return concat(l, r);
+	}
+
+	// AVL style join: walk down the spine of the taller rope until the
+	// heights match, then rebalance on the way back up
+	static Ref join(const Ref& l, const Ref& r) {
+		if (l->length == 0) {
+			return r;
+		}
+		if (r->length == 0) {
+			return l;
+		}
+		if (l->kind == RopeNode::LEAF && r->kind == RopeNode::LEAF && l->length + r->length <= SMALL) {
+			return leaf(l->view(), r->view());
+		}
+		if (l->height > r->height + 1) {
+			return balance(l->left, join(l->right, r));
+		}
+		if (r->height > l->height + 1) {
+			return balance(join(l, r->left), r->right);
+		}
+		return concat(l, r);
+	}
+
+public:
+	// maps arena nodes to their heap copies, so that a promotion keeps
+	// subtrees shared between values shared
+	typedef unordered_map<const RopeNode *, Ref> Promotion;
+
+	Rope() {
+	}
+	explicit Rope(string s) {
+		if (!s.empty()) {
+			node = make(ExecArena::active(), std::move(s));
+		}
+	}
+	explicit Rope(string_view s) {
+		if (!s.empty()) {
+			node = leaf(s);
+		}
+	}
+	explicit Rope(const char *s) :
+			Rope(string_view(s)) {
+	}
+
+	size_t size() const {
+		return node ? node->length : 0;
+	}
+
+	// flattens the rope; the result is cached in the node
+	string_view view() const {
+		return node ? node->view() : string_view();
+	}
+
+	bool isInterned() const {
+		return node && node->interned;
+	}
+
+	// a heap leaf holding s, whatever arena is active
+	static Rope heapLeaf(string s) {
+		return Rope(make(nullptr, std::move(s)));
+	}
+
+	// a heap leaf that the intern table can hand out as the canonical copy of s
+	static Rope internedLeaf(string s) {
+		shared_ptr<RopeNode> n = allocate_shared<RopeNode>(CountingAllocator<RopeNode, StringAccount>(), nullptr,
+				std::move(s));
+		n->interned = true;
+		return Rope(n);
+	}
+
+	Rope operator+(const Rope& r) const {
+		if (!node) {
+			return r;
+		}
+		if (!r.node) {
+			return *this;
+		}
+		return Rope(join(node, r.node));
+	}
+
+	// returns false if the result would be too long to represent
+	bool repeat(size_t n, Rope& result) const {
+		if (n != 0 && size() > string().max_size() / n) {
+			return false;
+		}
+		if (n == 1) {
+			result = *this;
+		}
+		else if (n == 0 || size() == 0) {
+			result = Rope();
+		}
+		else if (node->length * n <= SMALL) {
+			result = Rope(make(ExecArena::active(), node->view(), n));
+		}
+		else {
+			result = Rope(make(ExecArena::active(), node, n));
+		}
+		return true;
+	}
+
+	// returns this rope with every arena node replaced by a heap copy
+	Rope promote(Promotion& done) const {
+		return (node && node->arenaBacked) ? Rope(promote(node, done)) : *this;
+	}
+
+	int compare(const Rope& r) const {
+		if (node == r.node) {
+			return 0;
+		}
+		string_view a = view(), b = r.view();
+		return StrKernels::compare(a.data(), a.size(), b.data(), b.size());
+	}
+
+	bool equals(const Rope& r) const {
+		if (node == r.node) {
+			return true;
+		}
+		// interned strings have exactly one node per distinct text
+		if (isInterned() && r.isInterned()) {
+			return false;
+		}
+		if (size() != r.size()) {
+			return false;
+		}
+		string_view a = view(), b = r.view();
+		return StrKernels::equal(a.data(), a.size(), b.data(), b.size());
+	}
+
+	template<class Out>
+	void writeTo(Out& out) const {
+		if (node) {
+			node->writeTo(out);
+		}
+	}
+
+	friend ostream& operator<<(ostream& out, const Rope& r) {
+		r.writeTo(out);
+		return out;
+	}
+
+private:
+	static Ref promote(const Ref& n, Promotion& done) {
+		if (!n->arenaBacked) {
+			return n;
+		}
+		Promotion::const_iterator it = done.find(n.get());
+		if (it != done.end()) {
+			return it->second;
+		}
+		Ref copy;
+		if (n->kind == RopeNode::LEAF || n->text.load(memory_order_acquire)) {
+			copy = make(nullptr, string(n->view()));
+		}
+		else if (n->kind == RopeNode::CONCAT) {
+			copy = make(nullptr, promote(n->left, done), promote(n->right, done));
+		}
+		else {
+			copy = make(nullptr, promote(n->left, done), n->count);
+		}
+		RopeStats::promoted++;
+		done[n.get()] = copy;
+		return copy;
+	}
+};
+
+#endif /* ROPE_H_ */
@@ -2,17 +2,114 @@
  * rtError.h
  */
 
+#ifndef RTERROR_H_
+#define RTERROR_H_
 
-#include "value.h"
+#include <string>
+#include "output.h"
+#include "trace.h"
 using namespace std;
 
-static bool error = false;
+// a runtime error on its way out of Eval. It is thrown where the failure is
+// detected, with no line; the nearest enclosing node that evaluated the
+// failing one fills in its own line as the error passes through it
+class RuntimeError {
+public:
+	static const int NO_LINE = -1;
 
-static void runTimeError(int line, Value err) {
-	if (!error && err.isError()) {
-		cerr << line << ": " << err << endl;
-		error = true;
+	int line;
+	string message;
+	// raised by an execution budget; enclosing nodes keep the message
+	bool budget;
+	// the top level statements that completed before the failing one
+	size_t completed;
+
+	RuntimeError(const char *message, int line = NO_LINE) :
+			line(line), message(message), budget(false), completed(0) {
+	}
+
+	bool hasLine() const {
+		return line != NO_LINE;
 	}
+};
 
+// raising an error is kept out of line so that the operators only carry a
+// call on their failure branch
+[[noreturn]] __attribute__((noinline, cold)) inline void runTimeError(const char *msg) {
+	throw RuntimeError(msg);
 }
 
+[[noreturn]] __attribute__((noinline, cold)) inline void runTimeError(int line, const char *msg) {
+	throw RuntimeError(msg, line);
+}
+
+// a parse or runtime error, as the command line reports it with
+// "line: message" or "line: RUNTIME ERROR message"
+struct ScriptError {
+	enum Kind {
+		PARSE, RUNTIME
+	};
+
+	Kind kind;
+	int line;
+	string message;
+	// for a runtime error, the statements that completed before it
+	size_t completed;
+
+	// the report, without its newline
+	string text() const {
+		return to_string(line) + (kind == RUNTIME ? ": RUNTIME ERROR " : ": ") + message;
+	}
+};
+
+// the error state of the interpreter on this thread. Execution stops at the
+// first runtime error, so one is all there is to keep
+class ErrorState {
+	bool failed;
+	ScriptError error;
+
+	ErrorState() :
+			failed(false), error { ScriptError::RUNTIME, 0, string(), 0 } {
+	}
+
+public:
+	static ErrorState& current() {
+		static thread_local ErrorState state;
+		return state;
+	}
+
+	bool hasFailed() const {
+		return failed;
+	}
+	int getLine() const {
+		return error.line;
+	}
+	const string& getMessage() const {
+		return error.message;
+	}
+	const ScriptError& getError() const {
+		return error;
+	}
+
+	// keeps and reports the error unless one was already recorded
+	__attribute__((noinline, cold)) void record(const RuntimeError& e) {
+		if (failed) {
+			return;
+		}
+		failed = true;
+		TRACE_EVENT(ERROR, e.line);
+		error = ScriptError { ScriptError::RUNTIME, e.line, e.message, e.completed };
+		// everything printed before the error goes out ahead of it
+		OutputSink::active()->flush();
+		OutputSink& err = *OutputSink::activeError();
+		err << error.text() << '\n';
+		err.flush();
+	}
+
+	void clear() {
+		failed = false;
+		error = ScriptError { ScriptError::RUNTIME, 0, string(), 0 };
+	}
+};
+
+#endif /* RTERROR_H_ */
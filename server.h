@@ -0,0 +1,224 @@
+/*
+ * server.h
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "parse.h"
+#include "progcache.h"
+using namespace std;
+
+// daemon that runs scripts sent over a Unix domain socket, so that small
+// scripts do not pay for starting a process each time. The accepting thread
+// queues connections for a fixed pool of workers; each worker has its own
+// arena and runs one script at a time. Compiled scripts are kept in a
+// ProgramCache, so a script sent again is not parsed again.
+//
+// A client connects, sends one line naming the symbol table to run against
+// (an empty line for a fresh table that is thrown away afterwards) followed
+// by the script, and shuts down its side for writing. Named tables persist
+// between requests; requests on the same name run one after the other. The
+// reply is a sequence of frames:
+//   o <length>\n<bytes>   program output
+//   e <length>\n<bytes>   runtime errors
+//   x 0\n                 end of the reply
+//
+// A first line of !stats asks for the program cache's counters instead; the
+// reply is one s frame of "<name> <count>" lines, then the x frame. Names
+// starting with ! are kept for such requests
+class Server {
+	static const size_t MAX_REQUEST = 64 * 1024 * 1024;
+	static constexpr const char *STATS_REQUEST = "!stats";
+
+	string path;
+	size_t workers;
+	ExecBudget::Limits limits;
+	int listener;
+	ProgramCache cache;
+
+	mutex lock;
+	condition_variable ready;
+	deque<int> pending;
+
+	struct NamedTable {
+		mutex lock;
+		SymbolTable symbols;
+	};
+	mutex tablesLock;
+	// map nodes never move, so a table can be used after tablesLock is released
+	map<string, NamedTable> tables;
+
+public:
+	static const size_t DEFAULT_CACHE_BYTES = 64 * 1024 * 1024;
+
+	Server(const string& path, size_t workers, const ExecBudget::Limits& limits = ExecBudget::Limits(),
+			size_t cacheBytes = DEFAULT_CACHE_BYTES) :
+			path(path), workers(workers ? workers : 1), limits(limits), listener(-1), cache(cacheBytes) {
+	}
+
+	ProgramCache::Stats cacheStats() const {
+		return cache.stats();
+	}
+
+	// binds and listens on the socket, replacing a stale one; returns false
+	// after reporting on stderr if that fails
+	bool start() {
+		listener = listenOn(path);
+		return listener >= 0;
+	}
+
+	// accepts connections until the process is killed
+	void run() {
+		vector<thread> pool;
+		for (size_t i = 0; i < workers; i++) {
+			pool.emplace_back(&Server::work, this);
+		}
+		while (true) {
+			int fd = accept(listener, 0, 0);
+			if (fd < 0) {
+				continue;
+			}
+			{
+				lock_guard<mutex> guard(lock);
+				pending.push_back(fd);
+			}
+			ready.notify_one();
+		}
+	}
+
+	// a listening socket at path, replacing a stale one, or -1 after reporting
+	// on stderr
+	static int listenOn(const string& path) {
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof addr);
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof addr.sun_path) {
+			cerr << "SOCKET PATH TOO LONG " << path << endl;
+			return -1;
+		}
+		strcpy(addr.sun_path, path.c_str());
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(path.c_str());
+		if (fd < 0 || bind(fd, (sockaddr *) &addr, sizeof addr) < 0 || listen(fd, SOMAXCONN) < 0) {
+			cerr << "COULD NOT LISTEN ON " << path << ": " << strerror(errno) << endl;
+			if (fd >= 0) {
+				close(fd);
+			}
+			return -1;
+		}
+		// a client that goes away mid reply must not take the daemon with it
+		signal(SIGPIPE, SIG_IGN);
+		return fd;
+	}
+
+	// reads a request up to the client's shutdown; false if it fails or is
+	// too large
+	static bool readRequest(int fd, string& request) {
+		char buf[64 * 1024];
+		while (true) {
+			ssize_t n = read(fd, buf, sizeof buf);
+			if (n == 0) {
+				return true;
+			}
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			if (request.size() + n > MAX_REQUEST) {
+				return false;
+			}
+			request.append(buf, n);
+		}
+	}
+
+private:
+	void work() {
+		ExecArena arena;
+		while (true) {
+			int fd;
+			{
+				unique_lock<mutex> guard(lock);
+				ready.wait(guard, [this] {
+					return !pending.empty();
+				});
+				fd = pending.front();
+				pending.pop_front();
+			}
+			handle(fd, arena);
+			close(fd);
+		}
+	}
+
+	void handle(int fd, ExecArena& arena) {
+		string request;
+		if (!readRequest(fd, request)) {
+			return;
+		}
+		size_t eol = request.find('\n');
+		string name = request.substr(0, eol);
+		string script = eol == string::npos ? string() : request.substr(eol + 1);
+
+		if (name == STATS_REQUEST) {
+			OutputSink out(fd, OutputSink::BYTES);
+			out.setFrameTag('s');
+			ProgramCache::Stats s = cache.stats();
+			out << "hits " << to_string(s.hits) << "\nmisses " << to_string(s.misses) << "\nevictions "
+					<< to_string(s.evictions) << "\nentries " << to_string(s.entries) << "\nbytes " << to_string(s.bytes)
+					<< "\n";
+			out.flush();
+			send(fd, "x 0\n", 4, MSG_NOSIGNAL);
+			return;
+		}
+
+		OutputSink out(fd, OutputSink::BYTES), err(fd, OutputSink::BYTES);
+		out.setFrameTag('o');
+		err.setFrameTag('e');
+		OutputSink *previousOut = OutputSink::active();
+		OutputSink *previousErr = OutputSink::activeError();
+		OutputSink::active() = &out;
+		OutputSink::activeError() = &err;
+
+		shared_ptr<const ParseTree> prog = cache.get(script);
+		if (prog) {
+			// every request gets the whole budget, counted from here
+			ExecBudget budget(limits);
+			ExecBudget::Scope scope(limits.any() ? &budget : 0);
+			if (name.empty()) {
+				SymbolTable symbols;
+				prog->Run(&symbols, &arena);
+			}
+			else {
+				NamedTable *table;
+				{
+					lock_guard<mutex> guard(tablesLock);
+					table = &tables[name];
+				}
+				lock_guard<mutex> guard(table->lock);
+				prog->Run(&table->symbols, &arena);
+			}
+		}
+
+		OutputSink::active() = previousOut;
+		OutputSink::activeError() = previousErr;
+		out.flush();
+		err.flush();
+		send(fd, "x 0\n", 4, MSG_NOSIGNAL);
+	}
+};
+
+#endif /* SERVER_H_ */
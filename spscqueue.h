@@ -0,0 +1,85 @@
+/*
+ * spscqueue.h
+ */
+
+#ifndef SPSCQUEUE_H_
+#define SPSCQUEUE_H_
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+using namespace std;
+
+// bounded ring buffer between exactly one producer thread and one consumer
+// thread. head and tail only ever grow and each is written by one side, so
+// no locks are needed; a side that finds the queue full or empty sleeps on
+// the other side's counter until it moves
+template<class T>
+class SpscQueue {
+	vector<T> slots;
+	size_t mask;
+
+	// next slot to read, written by the consumer
+	alignas(64) atomic<size_t> head;
+	// next slot to write, written by the producer
+	alignas(64) atomic<size_t> tail;
+
+public:
+	// capacity is rounded up to a power of two
+	explicit SpscQueue(size_t capacity) :
+			head(0), tail(0) {
+		size_t n = 1;
+		while (n < capacity) {
+			n *= 2;
+		}
+		slots.resize(n);
+		mask = n - 1;
+	}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	size_t capacity() const {
+		return slots.size();
+	}
+
+	// blocks while the queue is full
+	void push(T v) {
+		size_t t = tail.load(memory_order_relaxed);
+		size_t h = head.load(memory_order_acquire);
+		while (t - h == slots.size()) {
+			head.wait(h, memory_order_acquire);
+			h = head.load(memory_order_acquire);
+		}
+		slots[t & mask] = std::move(v);
+		tail.store(t + 1, memory_order_release);
+		tail.notify_one();
+	}
+
+	// takes the front element if there is one, without waiting
+	bool tryPop(T& v) {
+		size_t h = head.load(memory_order_relaxed);
+		if (tail.load(memory_order_acquire) == h) {
+			return false;
+		}
+		v = std::move(slots[h & mask]);
+		head.store(h + 1, memory_order_release);
+		head.notify_one();
+		return true;
+	}
+
+	// blocks while the queue is empty
+	T pop() {
+		size_t h = head.load(memory_order_relaxed);
+		size_t t = tail.load(memory_order_acquire);
+		while (t == h) {
+			tail.wait(t, memory_order_acquire);
+			t = tail.load(memory_order_acquire);
+		}
+		T v = std::move(slots[h & mask]);
+		head.store(h + 1, memory_order_release);
+		head.notify_one();
+		return v;
+	}
+};
+
+#endif /* SPSCQUEUE_H_ */
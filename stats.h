@@ -0,0 +1,217 @@
+/*
+ * stats.h
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <chrono>
+#include <sys/resource.h>
+#include "tokens.h"
+#include "perfcount.h"
+#include "trace.h"
+using namespace std;
+
+// what --stats reports about a run: the wall time and throughput of each
+// phase, and the sizes the run reached. The parser pulls its tokens as it
+// goes, so the lexer is timed on a pass of its own over the source, and the
+// parse time includes lexing again. Given counters, each phase is counted
+// too, and the report adds IPC and misses per token or per node
+struct RunStats {
+	size_t bytes;
+	size_t tokens;
+	double lexSeconds;
+	size_t nodes;
+	double parseSeconds;
+	size_t statements;
+	size_t prints;
+	double evalSeconds;
+	size_t symbols;
+	long peakRssKb;
+	PerfCounters *counters;
+	PerfCounters::Sample lexPerf;
+	PerfCounters::Sample parsePerf;
+	PerfCounters::Sample evalPerf;
+
+private:
+	chrono::steady_clock::time_point phaseStart;
+
+public:
+	RunStats(PerfCounters *counters = 0) :
+			bytes(0), tokens(0), lexSeconds(0), nodes(0), parseSeconds(0), statements(0), prints(0), evalSeconds(
+					0), symbols(0), peakRssKb(0), counters(counters) {
+	}
+
+	// starts a phase
+	void begin() {
+		if (counters != 0) {
+			counters->start();
+		}
+		phaseStart = chrono::steady_clock::now();
+	}
+
+	// the seconds since begin(), with the phase's counts in perf
+	double end(PerfCounters::Sample& perf) {
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - phaseStart).count();
+		if (counters != 0) {
+			perf = counters->stop();
+		}
+		return seconds;
+	}
+
+	// times getNextToken over the whole of source
+	void lex(const string& source) {
+		istringstream in(source);
+		int line = 0;
+		bytes = source.size();
+		TRACE_SPAN(LEX, -1);
+		begin();
+		for (Token t = getNextToken(&in, &line); t != DONE && t != ERR; t = getNextToken(&in, &line)) {
+			tokens++;
+		}
+		lexSeconds = end(lexPerf);
+	}
+
+	// the most memory the process has held, in kilobytes
+	void measureRss() {
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0) {
+			peakRssKb = usage.ru_maxrss;
+		}
+	}
+
+	void writeText(ostream& out) const {
+		out << "RUN STATS" << endl;
+		out << "lex: " << bytes << " bytes, " << tokens << " tokens in " << lexSeconds << "s, "
+				<< rate(tokens, lexSeconds) << " tokens/s, " << rate(bytes, lexSeconds) << " bytes/s" << endl;
+		out << "parse: " << nodes << " nodes in " << parseSeconds << "s, " << rate(nodes, parseSeconds)
+				<< " nodes/s" << endl;
+		out << "eval: " << statements << " statements, " << prints << " prints in " << evalSeconds << "s, "
+				<< rate(statements, evalSeconds) << " statements/s" << endl;
+		out << "symbols: " << symbols << endl;
+		out << "peak rss: " << peakRssKb << " KB" << endl;
+		if (counters != 0) {
+			out << "PERF COUNTERS" << endl;
+			if (!counters->getProblem().empty()) {
+				out << "unavailable: " << counters->getProblem() << endl;
+			}
+			writePerfText(out, "lex", lexPerf, tokens, "token");
+			writePerfText(out, "parse", parsePerf, nodes, "node");
+			writePerfText(out, "eval", evalPerf, nodes, "node");
+		}
+	}
+
+	void writeJson(ostream& out) const {
+		out << "{\"lex\": {\"bytes\": " << bytes << ", \"tokens\": " << tokens << ", \"seconds\": " << lexSeconds
+				<< ", \"tokens_per_second\": " << rate(tokens, lexSeconds) << ", \"bytes_per_second\": "
+				<< rate(bytes, lexSeconds) << "}, ";
+		out << "\"parse\": {\"nodes\": " << nodes << ", \"seconds\": " << parseSeconds << ", \"nodes_per_second\": "
+				<< rate(nodes, parseSeconds) << "}, ";
+		out << "\"eval\": {\"statements\": " << statements << ", \"prints\": " << prints << ", \"seconds\": "
+				<< evalSeconds << ", \"statements_per_second\": " << rate(statements, evalSeconds) << "}, ";
+		out << "\"symbols\": " << symbols << ", \"peak_rss_kb\": " << peakRssKb;
+		if (counters != 0) {
+			out << ", \"perf\": {";
+			writePerfJson(out, "lex", lexPerf, tokens, "token");
+			out << ", ";
+			writePerfJson(out, "parse", parsePerf, nodes, "node");
+			out << ", ";
+			writePerfJson(out, "eval", evalPerf, nodes, "node");
+			out << ", \"unavailable\": ";
+			if (counters->getProblem().empty()) {
+				out << "null";
+			}
+			else {
+				writeJsonString(out, counters->getProblem());
+			}
+			out << "}";
+		}
+		out << "}" << endl;
+	}
+
+private:
+	void writePerfText(ostream& out, const char *phase, const PerfCounters::Sample& perf, size_t units,
+			const char *unit) const {
+		out << phase << ":";
+		for (int e = 0; e < PerfCounters::EVENTS; e++) {
+			PerfCounters::Event event = PerfCounters::Event(e);
+			out << (e ? ", " : " ") << PerfCounters::name(event) << ' ';
+			writeCount(out, perf, event);
+			if ((event == PerfCounters::BRANCH_MISSES || event == PerfCounters::CACHE_MISSES) && perf.has(event)) {
+				out << " (";
+				writeRatio(out, perf, event, units);
+				out << '/' << unit << ')';
+			}
+		}
+		out << ", ipc ";
+		writeIpc(out, perf);
+		out << endl;
+	}
+
+	void writePerfJson(ostream& out, const char *phase, const PerfCounters::Sample& perf, size_t units,
+			const char *unit) const {
+		out << '"' << phase << "\": {";
+		for (int e = 0; e < PerfCounters::EVENTS; e++) {
+			PerfCounters::Event event = PerfCounters::Event(e);
+			out << '"' << PerfCounters::name(event) << "\": ";
+			writeCount(out, perf, event, "null");
+			if (event == PerfCounters::BRANCH_MISSES || event == PerfCounters::CACHE_MISSES) {
+				out << ", \"" << PerfCounters::name(event) << "_per_" << unit << "\": ";
+				writeRatio(out, perf, event, units, "null");
+			}
+			out << ", ";
+		}
+		out << "\"ipc\": ";
+		writeIpc(out, perf, "null");
+		out << '}';
+	}
+
+	static void writeCount(ostream& out, const PerfCounters::Sample& perf, PerfCounters::Event e,
+			const char *missing = "n/a") {
+		if (perf.has(e)) {
+			out << perf.value[e];
+		}
+		else {
+			out << missing;
+		}
+	}
+
+	static void writeRatio(ostream& out, const PerfCounters::Sample& perf, PerfCounters::Event e, size_t units,
+			const char *missing = "n/a") {
+		if (perf.has(e) && units > 0) {
+			out << (double) perf.value[e] / units;
+		}
+		else {
+			out << missing;
+		}
+	}
+
+	static void writeIpc(ostream& out, const PerfCounters::Sample& perf, const char *missing = "n/a") {
+		if (perf.has(PerfCounters::CYCLES) && perf.has(PerfCounters::INSTRUCTIONS) && perf.value[PerfCounters::CYCLES] > 0) {
+			out << (double) perf.value[PerfCounters::INSTRUCTIONS] / perf.value[PerfCounters::CYCLES];
+		}
+		else {
+			out << missing;
+		}
+	}
+
+	static void writeJsonString(ostream& out, const string& s) {
+		out << '"';
+		for (char c : s) {
+			if (c == '"' || c == '\\') {
+				out << '\\';
+			}
+			out << c;
+		}
+		out << '"';
+	}
+
+	static long long rate(size_t units, double seconds) {
+		return seconds > 0 ? (long long) (units / seconds) : 0;
+	}
+};
+
+#endif /* STATS_H_ */
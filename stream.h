@@ -0,0 +1,94 @@
+/*
+ * stream.h
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <thread>
+#include <atomic>
+#include <string>
+#include "parse.h"
+#include "spscqueue.h"
+using namespace std;
+
+// runs a program while it is still being read. This thread lexes and parses
+// one statement at a time and hands each through a bounded queue to an
+// executor thread, which runs it and frees it, so memory stays constant and
+// output appears as soon as a statement has run, however long the input is.
+// String constants are not interned, since the table keeps what it holds.
+//
+// A parse error stops the program at the statement where it is found: the
+// statements before it have already run, its messages are printed after
+// their output, and nothing after it runs. A runtime error stops the parser
+// at the next statement
+class StreamRunner {
+	static const size_t DEPTH = 1024;
+
+	SpscQueue<ParseTree *> queue;
+	atomic<bool> stopped;
+	// parse error messages, handed over with the end of the stream
+	string parseErrors;
+
+public:
+	StreamRunner(size_t depth = DEPTH) :
+			queue(depth), stopped(false) {
+	}
+
+	void run(istream *in, int *line, ExecArena *arena, const ExecBudget::Limits& limits = ExecBudget::Limits()) {
+		thread executor(&StreamRunner::execute, this, arena, limits);
+
+		// parse errors are collected here instead of being printed straight
+		// away, so that they come out after the statements ahead of them
+		OutputSink errors;
+		OutputSink *previous = OutputSink::active();
+		OutputSink::active() = &errors;
+		InternTable::Transient transient;
+
+		bool failed = false;
+		for (bool first = true; !stopped.load(memory_order_relaxed); first = false) {
+			ParseTree *stmt = NextStmt(in, line, first, &failed);
+			if (stmt == 0) {
+				break;
+			}
+			queue.push(stmt);
+		}
+
+		OutputSink::active() = previous;
+		parseErrors = errors.take();
+		queue.push(0);
+		executor.join();
+	}
+
+private:
+	ParseTree *next() {
+		ParseTree *stmt;
+		if (!queue.tryPop(stmt)) {
+			// about to wait for the parser, so whatever has been printed is
+			// all there is for now
+			OutputSink::active()->flush();
+			stmt = queue.pop();
+		}
+		return stmt;
+	}
+
+	void execute(ExecArena *arena, ExecBudget::Limits limits) {
+		// one budget for the whole stream, not one per statement
+		ExecBudget budget(limits);
+		ExecBudget::Scope scope(limits.any() ? &budget : 0);
+		while (ParseTree *stmt = next()) {
+			if (!stopped.load(memory_order_relaxed)) {
+				stmt->Eval(arena);
+				if (ErrorState::current().hasFailed()) {
+					stopped.store(true, memory_order_relaxed);
+				}
+			}
+			delete stmt;
+		}
+		if (!stopped.load(memory_order_relaxed)) {
+			*OutputSink::active() << parseErrors;
+		}
+	}
+};
+
+#endif /* STREAM_H_ */
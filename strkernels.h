@@ -0,0 +1,160 @@
+/*
+ * strkernels.h
+ */
+
+#ifndef STRKERNELS_H_
+#define STRKERNELS_H_
+
+#include <cstddef>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRKERNELS_X86 1
+#endif
+using namespace std;
+
+// byte kernels behind string comparison and repetition. The scan for the
+// first differing byte uses AVX2 when the cpu has it, SSE2 otherwise, and
+// plain bytes on other targets
+namespace StrKernels {
+
+// position of the lowest differing byte of two unequal little endian words
+inline size_t wordDifference(unsigned long long x, unsigned long long y) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return __builtin_ctzll(x ^ y) / 8;
+#else
+	return __builtin_clzll(x ^ y) / 8;
+#endif
+}
+
+inline size_t firstDifferenceScalar(const char *a, const char *b, size_t n) {
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		unsigned long long x, y;
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if (x != y) {
+			return i + wordDifference(x, y);
+		}
+	}
+	for (; i < n; i++) {
+		if (a[i] != b[i]) {
+			return i;
+		}
+	}
+	return n;
+}
+
+#ifdef STRKERNELS_X86
+inline size_t firstDifferenceSSE2(const char *a, const char *b, size_t n) {
+	if (n < 16) {
+		return firstDifferenceScalar(a, b, n);
+	}
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+		unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) ^ 0xFFFFu;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	if (i == n) {
+		return n;
+	}
+	// the last, partial vector overlaps bytes already known to be equal
+	i = n - 16;
+	__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+	__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+	unsigned mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y))) ^ 0xFFFFu;
+	return mask ? i + __builtin_ctz(mask) : n;
+}
+
+__attribute__((target("avx2"))) inline size_t firstDifferenceAVX2(const char *a, const char *b, size_t n) {
+	size_t i = 0;
+	// two vectors per iteration so that long equal runs stay load bound
+	for (; i + 64 <= n; i += 64) {
+		__m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		__m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i + 32));
+		__m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i + 32));
+		__m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(x0, y0), _mm256_cmpeq_epi8(x1, y1));
+		if (unsigned(_mm256_movemask_epi8(eq)) != 0xFFFFFFFFu) {
+			break;
+		}
+	}
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+		__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+		unsigned mask = ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	if (i == n) {
+		return n;
+	}
+	// n is at least 32, so the last vector can overlap instead of falling
+	// back to narrower loads
+	i = n - 32;
+	__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+	__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+	unsigned mask = ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+	return mask ? i + __builtin_ctz(mask) : n;
+}
+
+inline bool hasAVX2() {
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+
+// index of the first byte where a and b differ, or n if they are equal
+inline size_t firstDifference(const char *a, const char *b, size_t n) {
+#ifdef STRKERNELS_X86
+	if (n >= 32 && hasAVX2()) {
+		return firstDifferenceAVX2(a, b, n);
+	}
+	return firstDifferenceSSE2(a, b, n);
+#else
+	return firstDifferenceScalar(a, b, n);
+#endif
+}
+
+inline bool equal(const char *a, size_t an, const char *b, size_t bn) {
+	return an == bn && (a == b || firstDifference(a, b, an) == an);
+}
+
+// three way comparison of unsigned bytes, shorter string first on a tie,
+// matching std::string::compare
+inline int compare(const char *a, size_t an, const char *b, size_t bn) {
+	size_t n = an < bn ? an : bn;
+	size_t i = (a == b) ? n : firstDifference(a, b, n);
+	if (i < n) {
+		return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i]) ? -1 : 1;
+	}
+	return (an > bn) - (an < bn);
+}
+
+// writes piece count times into out: one copy, then the filled prefix is
+// doubled with bulk memcpy until it covers the whole buffer. piece may be
+// out itself when the first copy is already in place
+inline void repeat(char *out, const char *piece, size_t len, size_t count) {
+	size_t total = len * count;
+	if (total == 0) {
+		return;
+	}
+	if (piece != out) {
+		memcpy(out, piece, len);
+	}
+	size_t filled = len;
+	while (filled < total) {
+		size_t n = filled < total - filled ? filled : total - filled;
+		memcpy(out + filled, out, n);
+		filled += n;
+	}
+}
+
+}
+
+#endif /* STRKERNELS_H_ */
@@ -0,0 +1,157 @@
+/*
+ * threadpool.h
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+using namespace std;
+
+// fixed set of worker threads, each with its own deque of tasks. A worker
+// takes its newest task first and, once its own deque is empty, steals the
+// oldest task of another worker, so uneven task sizes even out without one
+// shared queue that every worker contends on. Tasks submitted from outside
+// the pool are dealt round robin; tasks submitted by a worker go to its own
+// deque
+class ThreadPool {
+	typedef function<void()> Task;
+
+	struct Worker {
+		mutex lock;
+		deque<Task> tasks;
+	};
+
+	vector<unique_ptr<Worker>> workers;
+	vector<thread> threads;
+
+	// woken when tasks arrive or the pool shuts down
+	mutex idleLock;
+	condition_variable idle;
+	// woken when the last outstanding task finishes
+	condition_variable drained;
+
+	atomic<size_t> queued;
+	atomic<size_t> outstanding;
+	atomic<size_t> next;
+	bool stopping;
+
+	// index of the pool worker running on this thread, or -1
+	static int& self() {
+		static thread_local int index = -1;
+		return index;
+	}
+
+public:
+	explicit ThreadPool(size_t n = thread::hardware_concurrency()) :
+			queued(0), outstanding(0), next(0), stopping(false) {
+		if (n == 0) {
+			n = 1;
+		}
+		for (size_t i = 0; i < n; i++) {
+			workers.emplace_back(new Worker);
+		}
+		for (size_t i = 0; i < n; i++) {
+			threads.emplace_back(&ThreadPool::work, this, i);
+		}
+	}
+
+	~ThreadPool() {
+		{
+			lock_guard<mutex> guard(idleLock);
+			stopping = true;
+		}
+		idle.notify_all();
+		for (thread& t : threads) {
+			t.join();
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const {
+		return workers.size();
+	}
+
+	void submit(Task task) {
+		outstanding++;
+		int me = self();
+		size_t target = me >= 0 ? me : next++ % workers.size();
+		{
+			lock_guard<mutex> guard(workers[target]->lock);
+			workers[target]->tasks.push_back(std::move(task));
+		}
+		{
+			lock_guard<mutex> guard(idleLock);
+			queued++;
+		}
+		idle.notify_one();
+	}
+
+	// blocks until every task submitted so far has finished
+	void wait() {
+		unique_lock<mutex> guard(idleLock);
+		drained.wait(guard, [this] {
+			return outstanding.load() == 0;
+		});
+	}
+
+private:
+	bool take(size_t me, Task& task) {
+		{
+			Worker& own = *workers[me];
+			lock_guard<mutex> guard(own.lock);
+			if (!own.tasks.empty()) {
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+		for (size_t i = 1; i < workers.size(); i++) {
+			Worker& victim = *workers[(me + i) % workers.size()];
+			lock_guard<mutex> guard(victim.lock);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work(size_t me) {
+		self() = me;
+		while (true) {
+			{
+				unique_lock<mutex> guard(idleLock);
+				idle.wait(guard, [this] {
+					return queued.load() > 0 || stopping;
+				});
+				if (queued.load() == 0) {
+					return;
+				}
+				queued--;
+			}
+			// a queued count was claimed, so some deque holds a task
+			Task task;
+			while (!take(me, task)) {
+				this_thread::yield();
+			}
+			task();
+			if (--outstanding == 0) {
+				lock_guard<mutex> guard(idleLock);
+				drained.notify_all();
+			}
+		}
+	}
+};
+
+#endif /* THREADPOOL_H_ */
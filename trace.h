@@ -0,0 +1,221 @@
+/*
+ * trace.h
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <ostream>
+#include <unistd.h>
+using namespace std;
+
+// a timeline of what the interpreter did, for --trace. Trace points at phase
+// boundaries, statements, prints and runtime errors write fixed size records
+// into a ring that belongs to their thread. Only that thread writes it, so
+// recording takes no lock, and once the ring is full the oldest records are
+// overwritten. writeChrome turns every thread's ring into Chrome's trace
+// event JSON, which chrome://tracing and Perfetto open.
+//
+// Building with INTERP_NO_TRACE removes the trace points altogether; built in
+// but not enabled, each one costs a load and a branch
+class Trace {
+public:
+	enum Kind : uint8_t {
+		LEX, PARSE, EVAL, STATEMENT, PRINT, ERROR
+	};
+	enum Phase : uint8_t {
+		BEGIN, END, INSTANT
+	};
+
+	struct Record {
+		int64_t nanos;
+		int32_t line;
+		Kind kind;
+		Phase phase;
+	};
+
+	static const size_t DEFAULT_RECORDS = 1 << 16;
+
+	// the records of one thread. The dumper may read while the thread writes:
+	// it reads the head before and after copying, and drops whatever the
+	// writer may have overwritten in between
+	class Ring {
+		vector<Record> records;
+		size_t mask;
+		atomic<uint64_t> head;
+
+	public:
+		const int thread;
+
+		// size is rounded up to a power of two
+		Ring(size_t size, int thread) :
+				head(0), thread(thread) {
+			size_t n = 1;
+			while (n < size) {
+				n *= 2;
+			}
+			records.resize(n);
+			mask = n - 1;
+		}
+
+		void record(const Record& r) {
+			uint64_t h = head.load(memory_order_relaxed);
+			records[h & mask] = r;
+			head.store(h + 1, memory_order_release);
+		}
+
+		// the records still in the ring, oldest first
+		vector<Record> snapshot() const {
+			uint64_t end = head.load(memory_order_acquire);
+			uint64_t start = end > records.size() ? end - records.size() : 0;
+			vector<Record> out;
+			out.reserve(end - start);
+			for (uint64_t i = start; i < end; i++) {
+				out.push_back(records[i & mask]);
+			}
+			atomic_thread_fence(memory_order_acquire);
+			uint64_t now = head.load(memory_order_relaxed);
+			uint64_t overwritten = now > records.size() ? now - records.size() : 0;
+			if (overwritten > start) {
+				out.erase(out.begin(), out.begin() + min(overwritten - start, (uint64_t) out.size()));
+			}
+			return out;
+		}
+	};
+
+	// starts recording on every thread, each into a ring of records entries
+	static void enable(size_t records = DEFAULT_RECORDS) {
+		ringSize() = records;
+		on().store(true, memory_order_release);
+	}
+
+	static void disable() {
+		on().store(false, memory_order_release);
+	}
+
+	static void event(Kind kind, Phase phase, int line) {
+		if (__builtin_expect(on().load(memory_order_relaxed), 0)) {
+			record(kind, phase, line);
+		}
+	}
+
+	// a begin record now and an end record when it goes out of scope, even
+	// if a runtime error is what ends it
+	class Span {
+		Kind kind;
+		int line;
+		bool recording;
+
+	public:
+		Span(Kind kind, int line) :
+				kind(kind), line(line), recording(on().load(memory_order_relaxed)) {
+			if (__builtin_expect(recording, 0)) {
+				record(kind, BEGIN, line);
+			}
+		}
+		~Span() {
+			if (__builtin_expect(recording, 0)) {
+				record(kind, END, line);
+			}
+		}
+	};
+
+	// every thread's records as {"traceEvents": [...]}, in microseconds from
+	// the earliest record. An end whose begin was overwritten is left out
+	static void writeChrome(ostream& out) {
+		static const char *names[] = { "lex", "parse", "eval", "statement", "print", "runtime error" };
+		static const char phases[] = { 'B', 'E', 'i' };
+		vector<pair<int, vector<Record>>> threads;
+		{
+			lock_guard<mutex> guard(ringsLock());
+			for (const unique_ptr<Ring>& r : rings()) {
+				threads.push_back(make_pair(r->thread, r->snapshot()));
+			}
+		}
+		int64_t origin = INT64_MAX;
+		for (const pair<int, vector<Record>>& t : threads) {
+			if (!t.second.empty()) {
+				origin = min(origin, t.second.front().nanos);
+			}
+		}
+		out << "{\"traceEvents\": [";
+		bool first = true;
+		for (const pair<int, vector<Record>>& t : threads) {
+			size_t depth = 0;
+			for (const Record& r : t.second) {
+				if (r.phase == END) {
+					if (depth == 0) {
+						continue;
+					}
+					depth--;
+				}
+				else if (r.phase == BEGIN) {
+					depth++;
+				}
+				out << (first ? "\n" : ",\n") << "{\"name\": \"" << names[r.kind] << "\", \"ph\": \""
+						<< phases[r.phase] << "\", \"ts\": " << (r.nanos - origin) / 1000.0 << ", \"pid\": " << getpid()
+						<< ", \"tid\": " << t.first;
+				if (r.phase == INSTANT) {
+					out << ", \"s\": \"t\"";
+				}
+				if (r.line >= 0) {
+					out << ", \"args\": {\"line\": " << r.line << "}";
+				}
+				out << '}';
+				first = false;
+			}
+		}
+		out << "\n]}" << endl;
+	}
+
+private:
+	static atomic<bool>& on() {
+		static atomic<bool> enabled(false);
+		return enabled;
+	}
+
+	static size_t& ringSize() {
+		static size_t size = DEFAULT_RECORDS;
+		return size;
+	}
+
+	static mutex& ringsLock() {
+		static mutex lock;
+		return lock;
+	}
+
+	// every ring made, kept past the end of its thread so that it can still
+	// be dumped
+	static vector<unique_ptr<Ring>>& rings() {
+		static vector<unique_ptr<Ring>> all;
+		return all;
+	}
+
+	__attribute__((noinline)) static void record(Kind kind, Phase phase, int line) {
+		static thread_local Ring *ring = nullptr;
+		if (ring == nullptr) {
+			lock_guard<mutex> guard(ringsLock());
+			rings().push_back(make_unique<Ring>(ringSize(), (int) rings().size() + 1));
+			ring = rings().back().get();
+		}
+		int64_t nanos = chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now().time_since_epoch()).count();
+		ring->record(Record { nanos, line, kind, phase });
+	}
+};
+
+#ifdef INTERP_NO_TRACE
+#define TRACE_SPAN(kind, line)
+#define TRACE_EVENT(kind, line)
+#else
+#define TRACE_SPAN(kind, line) Trace::Span traceSpan(Trace::kind, line)
+#define TRACE_EVENT(kind, line) Trace::event(Trace::kind, Trace::INSTANT, line)
+#endif
+
+#endif /* TRACE_H_ */
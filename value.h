@@ -6,52 +6,99 @@
 #define VALUE_H_
 
 #include <string>
+#include <map>
+#include <memory>
 #include <iostream>
+#include "rope.h"
+#include "bigint.h"
+#include "rtError.h"
+#include "output.h"
+#include "budget.h"
+#include "profile.h"
+#include "memory.h"
 using namespace std;
 
-// object holds boolean, integer, or string, and remembers which it holds
+// object holds boolean, integer, or string, and remembers which it holds.
+// Integers are 64-bit. A result that overflows is promoted to an isBigInt,
+// which holds the BigInt behind a shared pointer so that the small-int case
+// does not carry its digits, and is only formatted when it is printed; a
+// BigInt result that fits in 64 bits becomes an isInt again.
+// Operations on the wrong types raise a RuntimeError instead of returning a value
 class Value {
-	bool bval;
-	int ival;
-	string sval;
 	enum VT {
-		isBool, isInt, isString, isTypeError
+		isBool, isInt, isString, isTypeError, isBigInt
 	} type;
+	bool bval;
+	long long ival;
+	Rope sval;
+	shared_ptr<const BigInt> big;
 
 public:
 
 	Value() :
-			bval(false), ival(0), type(isTypeError) {
+			type(isTypeError), bval(false), ival(0) {
 	}
 	Value(bool bval) :
-			bval(bval), ival(0), type(isBool) {
+			type(isBool), bval(bval), ival(0) {
 	}
 	Value(int ival) :
-			bval(false), ival(ival), type(isInt) {
+			type(isInt), bval(false), ival(ival) {
+	}
+	Value(long long ival) :
+			type(isInt), bval(false), ival(ival) {
+	}
+	Value(BigInt b) :
+			type(isInt), bval(false), ival(0) {
+		if (b.fitsInt64()) {
+			ival = b.toInt64();
+		}
+		else {
+			big = make_shared<const BigInt>(std::move(b));
+			type = isBigInt;
+		}
 	}
 	Value(string sval) :
-			bval(false), ival(0), sval(sval), type(isString) {
+			type(isString), bval(false), ival(0), sval(std::move(sval)) {
+	}
+	Value(Rope sval) :
+			type(isString), bval(false), ival(0), sval(std::move(sval)) {
 	}
 
-	// in the case of an error, I use the value to hold the error message
-	Value(string sval, bool isError) :
-			bval(false), ival(0), sval(sval), type(isTypeError) {
+	// false only for a default constructed Value, which holds nothing
+	bool hasValue() const {
+		return type != VT::isTypeError;
 	}
 
 	bool isBoolType() const {
 		return type == VT::isBool;
 	}
 	bool isIntType() const {
-		return type == VT::isInt;
+		return type == VT::isInt || type == VT::isBigInt;
 	}
 	bool isStringType() const {
 		return type == VT::isString;
 	}
-	bool isError() const {
-		return type == VT::isTypeError;
+	// an integer that fits in 64 bits
+	bool isSmallInt() const {
+		return type == VT::isInt;
 	}
-	bool hasMessage() const {
-		return isError() && sval.size() > 0;
+
+	// same type and same contents. Unlike ==, any two values compare, and
+	// an empty Value is the same only as another empty one
+	bool sameAs(const Value& v) const {
+		if (type != v.type) {
+			return false;
+		}
+		if (type == VT::isBool) {
+			return bval == v.bval;
+		}
+		if (type == VT::isInt) {
+			return ival == v.ival;
+		}
+		if (type == VT::isBigInt) {
+			return big->compare(*v.big) == 0;
+		}
+		return type == VT::isTypeError || sval.equals(v.sval);
 	}
 
 	bool isTrue() const {
@@ -59,26 +106,32 @@ public:
 	}
 	bool getBoolean() const {
 		if (!isBoolType())
-			throw "Not boolean valued";
+			runTimeError("Not boolean valued");
 		return bval;
 	}
 
-	int getInteger() const {
-		if (!isIntType())
-			throw "Not integer valued";
+	long long getInteger() const {
+		if (type != VT::isInt)
+			runTimeError("Not integer valued");
 		return ival;
 	}
 
-	string getString() const {
+	BigInt getBigInteger() const {
+		if (!isIntType())
+			runTimeError("Not integer valued");
+		return type == VT::isBigInt ? *big : BigInt(ival);
+	}
+
+	string_view getString() const {
 		if (!isStringType())
-			throw "Not string valued";
-		return sval;
+			runTimeError("Not string valued");
+		return sval.view();
 	}
 
-	string getMessage() const {
-		if (!hasMessage())
-			throw "No message";
-		return sval;
+	// copies a string payload that lives in the execution arena to the heap,
+	// for values that outlive the execution
+	void promote(Rope::Promotion& done) {
+		sval = sval.promote(done);
 	}
 
 	friend ostream& operator<<(ostream& out, const Value& v) {
@@ -88,143 +141,160 @@ public:
 			out << v.ival;
 		else if (v.type == VT::isString)
 			out << v.sval;
-		else if (v.sval.size() > 0)
-			out << "RUNTIME ERROR " << v.sval;
+		else if (v.type == VT::isBigInt)
+			out << v.big->toString();
+		else
+			out << "TYPE ERROR";
+		return out;
+	}
+
+	// the same text through the output sink, with integers formatted by to_chars
+	friend OutputSink& operator<<(OutputSink& out, const Value& v) {
+		if (v.type == VT::isBool)
+			out << (v.bval ? "True" : "False");
+		else if (v.type == VT::isInt)
+			out << v.ival;
+		else if (v.type == VT::isString)
+			v.sval.writeTo(out);
+		else if (v.type == VT::isBigInt)
+			out << v.big->toString();
 		else
-			out << "TYPE ERROR" << v.sval;
+			out << "TYPE ERROR";
 		return out;
 	}
 
 	Value operator+(const Value& v) {
+		long long r;
+		if (this->areSmallInts(v) && !__builtin_add_overflow(this->ival, v.ival, &r)) {
+			return Value(r);
+		}
 		if (this->areInts(v)) {
-			return Value(this->ival + v.ival);
+			return bigArith('+', *this, v);
 		}
 		if (this->areStrings(v)) {
+			size_t length = this->sval.size() + v.sval.size();
+			chargeString(length);
+			profileString(length);
+			MemoryStats::OperatorScope scope;
 			return Value(this->sval + v.sval);
 		}
-		Value ret = Value("Invalid operands for +", true);
-
-		return ret;
+		runTimeError("Invalid operands for +");
 	}
 
 	Value operator-(const Value& v) {
-		return (this->areInts(v)) ? Value(this->ival - v.ival) : Value("Invalid operands for -", true);
+		long long r;
+		if (this->areSmallInts(v) && !__builtin_sub_overflow(this->ival, v.ival, &r)) {
+			return Value(r);
+		}
+		if (this->areInts(v)) {
+			return bigArith('-', *this, v);
+		}
+		runTimeError("Invalid operands for -");
 	}
 
 	Value operator*(const Value& v) {
+		long long r;
+		if (this->areSmallInts(v) && !__builtin_mul_overflow(this->ival, v.ival, &r)) {
+			return Value(r);
+		}
 		if (this->areInts(v)) {
-			return Value(this->ival * v.ival);
+			return bigArith('*', *this, v);
 		}
 		if (this->isIntType() && v.isStringType()) {
-			if (this->ival < 0) {
-				return Value("Can't multiply string by a negative", true);
+			if (this->isNegative()) {
+				runTimeError("Can't multiply string by a negative");
 			}
 			else {
-				string val = "";
-				for (int i = 0; i < this->ival; i++) {
-					val += v.sval;
-				}
-				return Value(val);
+				return repeat(v.sval, *this);
 			}
 		}
 
 		if (this->isStringType() && v.isIntType()) {
-			if (v.ival < 0) {
-				return Value("Can't multiply string by a negative", true);
+			if (v.isNegative()) {
+				runTimeError("Can't multiply string by a negative");
 			}
 			else {
-				string val = "";
-				for (int i = 0; i < v.ival; i++) {
-					val += this->sval;
-				}
-				return Value(val);
+				return repeat(this->sval, v);
 			}
 		}
 		if (this->isIntType() && v.isBoolType()) {
 			return Value(!v.getBoolean());
 		}
-		return Value("Invalid operands for *", true);
+		runTimeError("Invalid operands for *");
 	}
 	Value operator/(const Value& v) {
-		if (v.ival == 0) {
-			Value ret = Value("Division by 0", true);
-			return ret;
+		if (v.ival == 0 && v.type != VT::isBigInt) {
+			runTimeError("Division by 0");
 		}
-		if (this->areInts(v)) {
+		// LLONG_MIN / -1 is the one quotient that overflows
+		if (this->areSmallInts(v) && !(this->ival == LLONG_MIN && v.ival == -1)) {
 			return Value(this->ival / v.ival);
 		}
-		Value ret = Value("Invalid operands for /", true);
-
-		return ret;
+		if (this->areInts(v)) {
+			return bigArith('/', *this, v);
+		}
+		runTimeError("Invalid operands for /");
 	}
 
 	Value operator<(const Value& v) {
-		if (this->areInts(v)) {
+		if (this->areSmallInts(v)) {
 			return Value(this->ival < v.ival);
 		}
+		if (this->areInts(v)) {
+			return Value(bigCompare(*this, v) < 0);
+		}
 		if (this->areStrings(v)) {
+			// comparing flattens both ropes
+			MemoryStats::OperatorScope scope;
 			return Value(this->sval.compare(v.sval) < 0);
 		}
-		Value ret = Value("Invalid operands for <", true);
-
-		return ret;
+		runTimeError("Invalid operands for <");
 	}
 	Value operator<=(const Value& v) {
-		if (this->areInts(v)) {
+		if (this->areSmallInts(v)) {
 			return Value(this->ival <= v.ival);
 		}
+		if (this->areInts(v)) {
+			return Value(bigCompare(*this, v) <= 0);
+		}
 		if (this->areStrings(v)) {
+			MemoryStats::OperatorScope scope;
 			return Value(this->sval.compare(v.sval) <= 0);
 		}
-		Value ret = Value("Invalid operands for <=", true);
-
-		return ret;
+		runTimeError("Invalid operands for <=");
 
 	}
 	Value operator>(const Value& v) {
-		if (this->areInts(v)) {
+		if (this->areSmallInts(v)) {
 			return Value(this->ival > v.ival);
 		}
+		if (this->areInts(v)) {
+			return Value(bigCompare(*this, v) > 0);
+		}
 		if (this->areStrings(v)) {
+			MemoryStats::OperatorScope scope;
 			return Value(this->sval.compare(v.sval) > 0);
 		}
-		Value ret = Value("Invalid operands for >", true);
-
-		return ret;
+		runTimeError("Invalid operands for >");
 	}
 	Value operator>=(const Value& v) {
-		if (this->areInts(v)) {
+		if (this->areSmallInts(v)) {
 			return Value(this->ival >= v.ival);
 		}
+		if (this->areInts(v)) {
+			return Value(bigCompare(*this, v) >= 0);
+		}
 		if (this->areStrings(v)) {
+			MemoryStats::OperatorScope scope;
 			return Value(this->sval.compare(v.sval) >= 0);
 		}
-		Value ret = Value("Invalid operands for >=", true);
-
-		return ret;
+		runTimeError("Invalid operands for >=");
 	}
 	Value operator==(const Value& v) {
-		if (this->areInts(v)) {
-			return Value(this->ival == v.ival);
-		}
-		if (this->areStrings(v)) {
-			return Value(this->sval.compare(v.sval) == 0);
-		}
-		if (this->areBools(v)) {
-			return Value(this->bval == v.bval);
-		}
-		Value ret = Value("Invalid operands for ==", true);
-
-		return ret;
+		return Value(this->equalTo(v, "Invalid operands for =="));
 	}
 	Value operator!=(const Value& v) {
-		Value ans = this->operator==(v);
-		if (ans.type != VT::isTypeError) {
-			return Value(!ans.bval);
-		}
-		Value ret = Value("Invalid operands for !=", true);
-
-		return ret;
+		return Value(!this->equalTo(v, "Invalid operands for !="));
 	}
 
 	Value operator&&(const Value& v) {
@@ -236,9 +306,7 @@ public:
 		if (this->areBools(v)) {
 			return Value(this->bval && v.bval);
 		}
-		Value ret = Value("Invalid operands for &&", true);
-
-		return ret;
+		runTimeError("Invalid operands for &&");
 	}
 
 	Value operator||(const Value& v) {
@@ -250,23 +318,118 @@ public:
 		if (this->areBools(v)) {
 			return Value(this->bval || v.bval);
 		}
-		Value ret = Value("Invalid operands for ||", true);
-
-		return ret;
+		runTimeError("Invalid operands for ||");
 	}
 
 private:
-	bool areInts(const Value& v) {
+	static Value repeat(const Rope& s, const Value& count) {
+		MemoryStats::OperatorScope scope;
+		Rope val;
+		if (count.type == VT::isBigInt) {
+			runTimeError("String too long");
+		}
+		chargeString(s.size(), count.ival);
+		if (!s.repeat(count.ival, val)) {
+			runTimeError("String too long");
+		}
+		profileString(val.size());
+		return Value(val);
+	}
+
+	static void chargeString(size_t length, size_t count = 1) {
+		if (ExecBudget *budget = ExecBudget::active()) {
+			budget->chargeString(length, count);
+		}
+	}
+
+	static void profileString(size_t length) {
+		if (Profiler *profiler = Profiler::active()) {
+			profiler->chargeString(length);
+		}
+	}
+
+	// shared by == and !=, which report the mismatch under their own name
+	bool equalTo(const Value& v, const char *mismatch) const {
+		if (this->areSmallInts(v)) {
+			return this->ival == v.ival;
+		}
+		if (this->areInts(v)) {
+			return bigCompare(*this, v) == 0;
+		}
+		if (this->areStrings(v)) {
+			MemoryStats::OperatorScope scope;
+			return this->sval.equals(v.sval);
+		}
+		if (this->areBools(v)) {
+			return this->bval == v.bval;
+		}
+		runTimeError(mismatch);
+	}
+
+	bool areInts(const Value& v) const {
 		return this->isIntType() && v.isIntType();
 	}
 
-	bool areStrings(const Value& v) {
+	bool areSmallInts(const Value& v) const {
+		return this->type == VT::isInt && v.type == VT::isInt;
+	}
+
+	bool isNegative() const {
+		return type == VT::isBigInt ? big->isNegative() : ival < 0;
+	}
+
+	// this integer as a BigInt: the one held, or a small one widened into
+	// scratch
+	const BigInt& bigOf(BigInt& scratch) const {
+		if (type == VT::isBigInt) {
+			return *big;
+		}
+		scratch = BigInt(ival);
+		MemoryStats::OperatorScope::count(scratch.heapBytes());
+		return scratch;
+	}
+
+	// the BigInt paths are kept out of line so that the small-int operators
+	// stay small enough to inline
+	__attribute__((noinline, cold)) static Value bigArith(char op, const Value& a, const Value& b) {
+		MemoryStats::OperatorScope scope;
+		BigInt xs, ys;
+		const BigInt& x = a.bigOf(xs);
+		const BigInt& y = b.bigOf(ys);
+		BigInt r;
+		switch (op) {
+		case '+':
+			r = x + y;
+			break;
+		case '-':
+			r = x - y;
+			break;
+		case '*':
+			r = x * y;
+			break;
+		default:
+			r = x / y;
+		}
+		// the digits of the result
+		MemoryStats::OperatorScope::count(r.heapBytes());
+		return Value(std::move(r));
+	}
+
+	__attribute__((noinline, cold)) static int bigCompare(const Value& a, const Value& b) {
+		BigInt xs, ys;
+		return a.bigOf(xs).compare(b.bigOf(ys));
+	}
+
+	bool areStrings(const Value& v) const {
 		return this->isStringType() && v.isStringType();
 	}
 
-	bool areBools(const Value& v) {
+	bool areBools(const Value& v) const {
 		return this->isBoolType() && v.isBoolType();
 	}
 };
 
+// variables by name. The map's nodes are counted in MemoryStats::symbols
+typedef map<string, Value, less<string>, CountingAllocator<pair<const string, Value>, SymbolAccount>> SymbolTable;
+
 #endif /* VALUE_H_ */